@@ -0,0 +1,1058 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+	Renders a project offscreen along a camera path and reports timings.
+	Uses a surfaceless EGL context when available, else a pbuffer, so it
+	runs without a window system, e.g. on Mesa llvmpipe.
+
+	pinked_bench [project] [--frames n] [--size w h] [--path file]
+				 [--dump dir] [--page-budget MiB] [--brushes]
+				 [--overdraw] [--unordered] [--raycast]
+
+	Without a project a generated test map is used. A path file holds one
+	key frame per line, "x y z yaw pitch distance" with angles in degrees,
+	frames are interpolated linearly between them. Afterwards a small scene
+	checks that baked light reaches the screen, the exit code is 1 if not.
+
+	With --brushes nothing is rendered, instead the blend kernels and
+	brushes are compared against a per voxel loop on the first layer and
+	shape brushes are timed on an empty one.
+
+	With --overdraw every frame is drawn twice more counting the fragments
+	that pass the depth test, once front to back and once in hash table
+	order, to report how often each covered pixel is shaded. --unordered
+	draws the timed frames in hash table order as well.
+
+	With --page-budget the pager hits, misses and evictions are reported
+	after the frames.
+
+	With --raycast the frames are rendered on the CPU by raycast.h instead,
+	no EGL context is created. --dump then writes the raycast images.
+*/
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cglm/cglm.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <SDL2/SDL.h>
+#undef main
+
+#include "blend.h"
+#include "brush.h"
+#include "camera.h"
+#include "edit_batch.h"
+#include "input_stream.h"
+#include "layer.h"
+#include "light.h"
+#include "pager.h"
+#include "raycast.h"
+#include "render.h"
+#include "thread_pool.h"
+
+struct bench_key {
+	vec3 target;
+	float yaw, pitch, distance;
+};
+
+struct bench_frame {
+	double cpu_ms;
+	double frame_ms;
+	double gpu_ms;
+	struct render_stats render;
+	// shaded fragments and covered pixels, front to back and unordered
+	size_t fragments[2];
+	size_t pixels[2];
+};
+
+static struct {
+	EGLDisplay display;
+	EGLSurface surface;
+	EGLContext context;
+	GLuint framebuffer;
+	GLuint renderbuffers[2];
+	int width, height;
+	// 8 bit channels, needed to count fragments
+	bool rgba8;
+	struct {
+		bool supported;
+		GLuint query;
+		PFNGLGENQUERIESEXTPROC gen;
+		PFNGLDELETEQUERIESEXTPROC destroy;
+		PFNGLBEGINQUERYEXTPROC begin;
+		PFNGLENDQUERYEXTPROC end;
+		PFNGLGETQUERYOBJECTUI64VEXTPROC result;
+	} timer;
+} bench;
+
+static bool bench_has_extension(const char* list, const char* name) {
+	size_t length = strlen(name);
+
+	for(const char* s = list ? strstr(list, name) : NULL; s;
+		s = strstr(s + length, name)) {
+		if((s == list || s[-1] == ' ')
+		   && (s[length] == ' ' || s[length] == '\0'))
+			return true;
+	}
+
+	return false;
+}
+
+static double bench_ms(Uint64 start) {
+	return (double)(SDL_GetPerformanceCounter() - start) * 1000.0
+		/ SDL_GetPerformanceFrequency();
+}
+
+static bool bench_init_egl(void) {
+	const char* client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	bench.display = EGL_NO_DISPLAY;
+
+	if(bench_has_extension(client, "EGL_MESA_platform_surfaceless")) {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC get_display
+			= (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+				"eglGetPlatformDisplayEXT");
+
+		if(get_display)
+			bench.display = get_display(EGL_PLATFORM_SURFACELESS_MESA,
+										EGL_DEFAULT_DISPLAY, NULL);
+	}
+
+	if(bench.display == EGL_NO_DISPLAY)
+		bench.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	if(bench.display == EGL_NO_DISPLAY
+	   || !eglInitialize(bench.display, NULL, NULL)
+	   || !eglBindAPI(EGL_OPENGL_ES_API))
+		return false;
+
+	EGLConfig config;
+	EGLint configs;
+
+	if(!eglChooseConfig(bench.display,
+						(EGLint[]) {EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+									EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+									EGL_NONE},
+						&config, 1, &configs)
+	   || !configs)
+		return false;
+
+	bench.context = eglCreateContext(
+		bench.display, config, EGL_NO_CONTEXT,
+		(EGLint[]) {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE});
+
+	if(bench.context == EGL_NO_CONTEXT)
+		return false;
+
+	// drawing always goes to a framebuffer object, the surface is unused
+	bench.surface = EGL_NO_SURFACE;
+
+	if(!bench_has_extension(eglQueryString(bench.display, EGL_EXTENSIONS),
+							"EGL_KHR_surfaceless_context")) {
+		bench.surface = eglCreatePbufferSurface(
+			bench.display, config,
+			(EGLint[]) {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE});
+
+		if(bench.surface == EGL_NO_SURFACE)
+			return false;
+	}
+
+	return eglMakeCurrent(bench.display, bench.surface, bench.surface,
+						  bench.context);
+}
+
+static bool bench_init_framebuffer(int width, int height) {
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+
+	bench.width = width;
+	bench.height = height;
+	bench.rgba8 = bench_has_extension(extensions, "GL_OES_rgb8_rgba8");
+
+	glGenFramebuffers(1, &bench.framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.framebuffer);
+	glGenRenderbuffers(2, bench.renderbuffers);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, bench.renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER,
+						  bench.rgba8 ? GL_RGBA8_OES : GL_RGB565, width,
+						  height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+							  GL_RENDERBUFFER, bench.renderbuffers[0]);
+
+	glBindRenderbuffer(GL_RENDERBUFFER, bench.renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width,
+						  height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+							  GL_RENDERBUFFER, bench.renderbuffers[1]);
+
+	glViewport(0, 0, width, height);
+
+	return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void bench_init_timer(void) {
+	bench.timer.supported = bench_has_extension(
+		(const char*)glGetString(GL_EXTENSIONS), "GL_EXT_disjoint_timer_query");
+
+	if(!bench.timer.supported)
+		return;
+
+	bench.timer.gen
+		= (PFNGLGENQUERIESEXTPROC)eglGetProcAddress("glGenQueriesEXT");
+	bench.timer.destroy
+		= (PFNGLDELETEQUERIESEXTPROC)eglGetProcAddress("glDeleteQueriesEXT");
+	bench.timer.begin
+		= (PFNGLBEGINQUERYEXTPROC)eglGetProcAddress("glBeginQueryEXT");
+	bench.timer.end = (PFNGLENDQUERYEXTPROC)eglGetProcAddress("glEndQueryEXT");
+	bench.timer.result = (PFNGLGETQUERYOBJECTUI64VEXTPROC)eglGetProcAddress(
+		"glGetQueryObjectui64vEXT");
+
+	bench.timer.supported = bench.timer.gen && bench.timer.destroy
+		&& bench.timer.begin && bench.timer.end && bench.timer.result;
+
+	if(bench.timer.supported)
+		bench.timer.gen(1, &bench.timer.query);
+}
+
+static void bench_destroy(void) {
+	if(bench.timer.supported)
+		bench.timer.destroy(1, &bench.timer.query);
+
+	glDeleteRenderbuffers(2, bench.renderbuffers);
+	glDeleteFramebuffers(1, &bench.framebuffer);
+
+	eglMakeCurrent(bench.display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+				   EGL_NO_CONTEXT);
+	eglDestroyContext(bench.display, bench.context);
+
+	if(bench.surface != EGL_NO_SURFACE)
+		eglDestroySurface(bench.display, bench.surface);
+
+	eglTerminate(bench.display);
+}
+
+static struct layer* bench_load_project(const char* path, size_t* count) {
+	FILE* f = fopen(path, "rb");
+
+	if(!f)
+		return NULL;
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	void* data = malloc(length > 0 ? length : 1);
+	assert(data);
+
+	struct layer* layers = NULL;
+
+	if(length > 0 && fread(data, length, 1, f) == 1) {
+		struct input_stream in;
+		ins_create(&in, length, data);
+		layers = layers_read(&in, count);
+	}
+
+	free(data);
+	fclose(f);
+
+	return layers;
+}
+
+// rolling hills with some towers, the same on every run
+static struct layer* bench_generate_project(size_t* count) {
+	struct layer* l = malloc(sizeof(struct layer));
+	assert(l);
+
+	layer_create(l, 0, 0, 0);
+
+	struct edit_batch batch;
+	edit_batch_create(&batch);
+
+	for(int x = -256; x < 256; x++) {
+		for(int y = -256; y < 256; y++) {
+			int height = 12 + (int)(6.0F * sinf(x / 23.0F) * cosf(y / 31.0F));
+
+			if(((x >> 5) ^ (y >> 5)) % 7 == 0 && (x & 31) >= 12
+			   && (x & 31) < 20 && (y & 31) >= 12 && (y & 31) < 20)
+				height += 24;
+
+			for(int z = 0; z < height; z++) {
+				edit_batch_set_solid(&batch, x, y, z,
+									 (struct color) {
+										 .red = 96 + z * 3,
+										 .green = 160 - z * 2,
+										 .blue = (x + 256) / 4,
+									 });
+			}
+		}
+	}
+
+	edit_batch_apply(&batch, l, NULL);
+	edit_batch_destroy(&batch);
+
+	*count = 1;
+	return l;
+}
+
+static struct bench_key* bench_load_path(const char* path, size_t* length) {
+	FILE* f = fopen(path, "r");
+
+	if(!f)
+		return NULL;
+
+	size_t capacity = 16;
+	struct bench_key* keys = malloc(capacity * sizeof(struct bench_key));
+	assert(keys);
+
+	*length = 0;
+
+	struct bench_key k;
+
+	while(fscanf(f, "%f %f %f %f %f %f", k.target + 0, k.target + 1,
+				 k.target + 2, &k.yaw, &k.pitch, &k.distance)
+		  == 6) {
+		if(*length == capacity) {
+			capacity *= 2;
+			keys = realloc(keys, capacity * sizeof(struct bench_key));
+			assert(keys);
+		}
+
+		keys[(*length)++] = k;
+	}
+
+	fclose(f);
+
+	if(!*length) {
+		free(keys);
+		return NULL;
+	}
+
+	return keys;
+}
+
+// one orbit around the origin
+static struct bench_key* bench_default_path(size_t* length) {
+	*length = 9;
+	struct bench_key* keys = malloc(*length * sizeof(struct bench_key));
+	assert(keys);
+
+	for(size_t k = 0; k < *length; k++)
+		keys[k] = (struct bench_key) {
+			.target = {0.0F, 0.0F, 8.0F},
+			.yaw = k * 45.0F,
+			.pitch = 35.0F,
+			.distance = (k & 1) ? 160.0F : 320.0F,
+		};
+
+	return keys;
+}
+
+static void bench_camera(struct bench_key* keys, size_t length, float t,
+						 struct camera* c) {
+	float position = t * (length - 1);
+	size_t a = (size_t)position;
+	size_t b = (a + 1 < length) ? a + 1 : a;
+	float f = position - a;
+
+	vec3 target;
+	glm_vec3_lerp(keys[a].target, keys[b].target, f, target);
+	camera_create(c, target[0], target[1], target[2]);
+
+	c->yaw = glm_rad(keys[a].yaw + (keys[b].yaw - keys[a].yaw) * f);
+	c->pitch = glm_rad(keys[a].pitch + (keys[b].pitch - keys[a].pitch) * f);
+	c->distance
+		= keys[a].distance + (keys[b].distance - keys[a].distance) * f;
+}
+
+static void bench_dump(const char* dir, size_t frame) {
+	char path[1024];
+	snprintf(path, sizeof(path), "%s/frame_%04zu.ppm", dir, frame);
+
+	FILE* f = fopen(path, "wb");
+
+	if(!f) {
+		printf("could not write %s\n", path);
+		return;
+	}
+
+	uint8_t* pixels = malloc(bench.width * bench.height * 4);
+	assert(pixels);
+
+	glReadPixels(0, 0, bench.width, bench.height, GL_RGBA, GL_UNSIGNED_BYTE,
+				 pixels);
+
+	fprintf(f, "P6\n%d %d\n255\n", bench.width, bench.height);
+
+	// rows are stored bottom up
+	for(int y = bench.height - 1; y >= 0; y--) {
+		for(int x = 0; x < bench.width; x++)
+			fwrite(pixels + (y * bench.width + x) * 4, 3, 1, f);
+	}
+
+	free(pixels);
+	fclose(f);
+}
+
+static void bench_overdraw(struct layer* layers, size_t count, mat4 mvp,
+						   bool ordered, size_t* fragments, size_t* pixels) {
+	layer_render_ordered(ordered);
+	render_set_overdraw(true);
+	render_set_mvp(mvp);
+
+	glClearColor(0.0F, 0.0F, 0.0F, 0.0F);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	for(size_t k = 0; k < count; k++)
+		layer_render(layers + k, mvp);
+
+	uint8_t* rgba = malloc(bench.width * bench.height * 4);
+	assert(rgba);
+
+	glReadPixels(0, 0, bench.width, bench.height, GL_RGBA, GL_UNSIGNED_BYTE,
+				 rgba);
+
+	*fragments = 0;
+	*pixels = 0;
+
+	// saturates at 255 fragments per pixel
+	for(int k = 0; k < bench.width * bench.height; k++) {
+		*fragments += rgba[k * 4];
+		*pixels += rgba[k * 4] > 0;
+	}
+
+	free(rgba);
+
+	render_set_overdraw(false);
+	glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+}
+
+// red channel of the pixel a world position is drawn at
+static uint8_t bench_sample(mat4 mvp, vec3 position) {
+	vec4 clip;
+	glm_mat4_mulv(mvp, (vec4) {position[0], position[1], position[2], 1.0F},
+				  clip);
+
+	int x = (int)((clip[0] / clip[3] * 0.5F + 0.5F) * bench.width);
+	int y = (int)((clip[1] / clip[3] * 0.5F + 0.5F) * bench.height);
+
+	uint8_t rgba[4];
+	glReadPixels(x, y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+	return rgba[0];
+}
+
+// the bottom of a one voxel wide pit has to come out darker than open ground
+static bool bench_check_light(void) {
+	struct layer l;
+	layer_create(&l, 0, 0, 0);
+
+	struct color gray = {200, 200, 200};
+
+	for(int y = -8; y <= 8; y++) {
+		for(int x = -8; x <= 8; x++)
+			layer_set_solid(&l, x, y, 0, gray);
+	}
+
+	for(int y = -1; y <= 1; y++) {
+		for(int x = -1; x <= 1; x++) {
+			if(x || y)
+				layer_set_solid(&l, x, y, 1, gray);
+		}
+	}
+
+	// looking straight down, both top faces get the same directional shade
+	struct camera camera;
+	camera_create(&camera, 3.0F, 0.5F, 1.0F);
+	camera.pitch = glm_rad(89.0F);
+	camera.distance = 24.0F;
+
+	mat4 mvp;
+	camera_matrix(&camera, (float)bench.width / bench.height, mvp);
+
+	// once to queue the bake, again to upload and draw it
+	for(int k = 0; k < 2; k++) {
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		render_set_mvp(mvp);
+		layer_render(&l, mvp);
+		light_wait();
+	}
+
+	uint8_t pit = bench_sample(mvp, (vec3) {0.5F, 0.5F, 1.0F});
+	uint8_t open = bench_sample(mvp, (vec3) {6.5F, 0.5F, 1.0F});
+
+	layer_destroy(&l);
+
+	printf("light check: open ground %d, pit bottom %d, %s\n", open, pit,
+		   pit < open ? "ok" : "FAILED");
+
+	return pit < open;
+}
+
+static int bench_compare(const void* a, const void* b) {
+	double A = *(const double*)a;
+	double B = *(const double*)b;
+	return (A > B) - (A < B);
+}
+
+static void bench_report(const char* name, double* values, size_t length) {
+	if(!length)
+		return;
+
+	double sum = 0.0;
+
+	for(size_t k = 0; k < length; k++)
+		sum += values[k];
+
+	qsort(values, length, sizeof(double), bench_compare);
+
+	printf("%-10s avg %8.3f  p50 %8.3f  p95 %8.3f  max %8.3f ms\n", name,
+		   sum / length, values[length / 2], values[length * 95 / 100],
+		   values[length - 1]);
+}
+
+static void bench_report_pager(void) {
+	if(!pager_enabled())
+		return;
+
+	struct pager_stats stats;
+	pager_stats(&stats);
+
+	printf("paging:   %zu hits, %zu misses, %zu evictions, %.1f MiB written, "
+		   "%.1f MiB read\n",
+		   stats.hits, stats.misses, stats.evictions,
+		   stats.bytes_written / 1048576.0, stats.bytes_read / 1048576.0);
+	printf("resident: %zu chunks, %.1f of %.1f MiB\n", stats.resident_chunks,
+		   stats.resident_bytes / 1048576.0, stats.budget / 1048576.0);
+}
+
+static bool bench_bounds_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+	int* bounds = (int*)user;
+	int pos[3] = {c->x, c->y, c->z};
+
+	for(int k = 0; k < 3; k++) {
+		int lo = pos[k] * LAYER_CHUNK_SIZE;
+		int hi = lo + LAYER_CHUNK_SIZE - 1;
+
+		if(lo < bounds[k])
+			bounds[k] = lo;
+
+		if(hi > bounds[k + 3])
+			bounds[k + 3] = hi;
+	}
+
+	return true;
+}
+
+static void bench_rate(const char* name, size_t voxels, double ms) {
+	printf("%-16s %9.3f ms  %9.1f Mvoxels/s\n", name, ms, voxels / ms / 1e3);
+}
+
+// one chunk of blocks, blended again and again
+static void bench_kernels(struct color color) {
+	struct layer_chunk_block* blocks
+		= malloc(LAYER_CHUNK_VOLUME * sizeof(struct layer_chunk_block));
+	uint16_t* weights = malloc(LAYER_CHUNK_VOLUME * sizeof(uint16_t));
+	assert(blocks && weights);
+
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		bool solid = (k * 7) % 4 != 0;
+		blocks[k] = (struct layer_chunk_block) {
+			.solid = solid,
+			.color = {
+				.red = solid ? k : 0,
+				.green = solid ? k >> 4 : 0,
+				.blue = solid ? k >> 8 : 0,
+			},
+		};
+		weights[k] = k % (BLEND_ONE + 1);
+	}
+
+	size_t rounds = 1024;
+	size_t voxels = rounds * LAYER_CHUNK_VOLUME;
+	printf("kernels:  %zu voxels per run\n", voxels);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	for(size_t r = 0; r < rounds; r++) {
+		for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+			if(blocks[k].solid)
+				blocks[k].color = color_blend(blocks[k].color, color, 0.5F);
+		}
+	}
+
+	bench_rate("color_blend", voxels, bench_ms(start));
+
+	const char* names[] = {"lerp row", "multiply row", "screen row"};
+	enum blend_op ops[] = {BLEND_LERP, BLEND_MULTIPLY, BLEND_SCREEN};
+
+	for(size_t k = 0; k < 3; k++) {
+		start = SDL_GetPerformanceCounter();
+
+		for(size_t r = 0; r < rounds; r++)
+			blend_row(blocks, LAYER_CHUNK_VOLUME, ops[k], color, weights);
+
+		bench_rate(names[k], voxels, bench_ms(start));
+	}
+
+	start = SDL_GetPerformanceCounter();
+
+	for(size_t r = 0; r < rounds; r++)
+		blend_gradient_row(blocks, LAYER_CHUNK_VOLUME, color,
+						   (struct color) {0}, weights);
+
+	bench_rate("gradient row", voxels, bench_ms(start));
+
+	free(weights);
+	free(blocks);
+}
+
+static void bench_brushes(struct layer* l) {
+	int bounds[6] = {INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN};
+	ht_iterate(&l->chunks, bounds, bench_bounds_callback);
+
+	if(!l->chunks.size) {
+		printf("layer is empty\n");
+		return;
+	}
+
+	int* min = bounds;
+	int* max = bounds + 3;
+	size_t voxels = (size_t)(max[0] - min[0] + 1) * (max[1] - min[1] + 1)
+		* (max[2] - min[2] + 1);
+	struct color color = {.red = 230, .green = 180, .blue = 40};
+
+	bench_kernels(color);
+
+	printf("brushes:  %d %d %d to %d %d %d, %zu voxels, %zu threads\n",
+		   min[0], min[1], min[2], max[0], max[1], max[2], voxels,
+		   thread_pool_threads());
+
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	for(int z = min[2]; z <= max[2]; z++) {
+		for(int y = min[1]; y <= max[1]; y++) {
+			for(int x = min[0]; x <= max[0]; x++) {
+				if(layer_is_solid(l, x, y, z))
+					layer_set_solid(
+						l, x, y, z,
+						color_blend(layer_get_color(l, x, y, z), color, 0.5F));
+			}
+		}
+	}
+
+	bench_rate("per voxel", voxels, bench_ms(start));
+
+	const char* names[] = {"lerp box", "multiply box", "screen box"};
+	enum blend_op ops[] = {BLEND_LERP, BLEND_MULTIPLY, BLEND_SCREEN};
+
+	for(size_t k = 0; k < 3; k++) {
+		start = SDL_GetPerformanceCounter();
+		brush_blend_box(l, min, max, ops[k], color, BLEND_ONE / 2);
+		bench_rate(names[k], voxels, bench_ms(start));
+	}
+
+	vec3 from = {min[0], min[1], min[2]};
+	vec3 to = {max[0], max[1], max[2]};
+	vec3 center;
+	glm_vec3_center(from, to, center);
+
+	start = SDL_GetPerformanceCounter();
+	brush_gradient_linear(l, min, max, from, to, color, (struct color) {0});
+	bench_rate("linear gradient", voxels, bench_ms(start));
+
+	start = SDL_GetPerformanceCounter();
+	brush_gradient_radial(l, min, max, center, glm_vec3_distance(from, to),
+						  color, (struct color) {0});
+	bench_rate("radial gradient", voxels, bench_ms(start));
+
+	// shapes on an empty layer, counted by their volume
+	struct layer shapes;
+	layer_create(&shapes, 0, 0, 0);
+
+	float radius = 200.0F;
+	float cube = radius * radius * radius;
+
+	start = SDL_GetPerformanceCounter();
+	brush_sphere(&shapes, (vec3) {0.0F, 0.0F, 0.0F}, radius, EDIT_SOLID,
+				 color);
+	bench_rate("sphere fill", 4.0F / 3.0F * GLM_PI * cube, bench_ms(start));
+
+	start = SDL_GetPerformanceCounter();
+	brush_cylinder(&shapes, (vec3) {0.0F, 0.0F, -radius}, radius / 2.0F,
+				   radius * 2.0F, EDIT_AIR, color);
+	bench_rate("cylinder erase", GLM_PI / 2.0F * cube, bench_ms(start));
+
+	layer_destroy(&shapes);
+}
+
+static bool bench_raycast(struct layer* layers, size_t count,
+						  const char* path, size_t frames, int width,
+						  int height, const char* dump) {
+	size_t keys_length;
+	struct bench_key* keys = path ? bench_load_path(path, &keys_length) :
+									bench_default_path(&keys_length);
+
+	if(!keys) {
+		printf("could not load camera path %s\n", path);
+		return false;
+	}
+
+	struct raycast_image img;
+	raycast_image_create(&img, width, height);
+
+	double* values = malloc(frames * sizeof(double));
+	assert(values);
+
+	double total = 0.0;
+
+	for(size_t frame = 0; frame < frames; frame++) {
+		struct camera camera;
+		bench_camera(keys, keys_length, (float)frame / (frames - 1), &camera);
+
+		Uint64 start = SDL_GetPerformanceCounter();
+		raycast_render(layers, count, &camera, &img);
+		values[frame] = bench_ms(start);
+		total += values[frame];
+
+		if(dump) {
+			char name[1024];
+			snprintf(name, sizeof(name), "%s/frame_%04zu.ppm", dump, frame);
+
+			if(!raycast_image_write(&img, name))
+				printf("could not write %s\n", name);
+		}
+
+		pager_collect();
+	}
+
+	printf("raycast:  %zu images at %dx%d on %zu threads, %.2f images/s\n",
+		   frames, width, height, thread_pool_threads(),
+		   frames * 1000.0 / total);
+	bench_report("image", values, frames);
+	bench_report_pager();
+
+	free(values);
+	free(keys);
+	raycast_image_destroy(&img);
+
+	return true;
+}
+
+int main(int argc, char** argv) {
+	const char* project = NULL;
+	const char* path = NULL;
+	const char* dump = NULL;
+	size_t frames = 240;
+	int width = 1280, height = 720;
+	bool brushes = false;
+	bool overdraw = false;
+	bool unordered = false;
+	bool raycast = false;
+
+	for(int k = 1; k < argc; k++) {
+		if(!strcmp(argv[k], "--frames") && k + 1 < argc) {
+			frames = (size_t)atoi(argv[++k]);
+		} else if(!strcmp(argv[k], "--size") && k + 2 < argc) {
+			width = atoi(argv[++k]);
+			height = atoi(argv[++k]);
+		} else if(!strcmp(argv[k], "--path") && k + 1 < argc) {
+			path = argv[++k];
+		} else if(!strcmp(argv[k], "--dump") && k + 1 < argc) {
+			dump = argv[++k];
+		} else if(!strcmp(argv[k], "--page-budget") && k + 1 < argc) {
+			if(!pager_init(NULL, (size_t)atoi(argv[++k]) * 1024 * 1024))
+				printf("could not create chunk store, paging disabled\n");
+		} else if(!strcmp(argv[k], "--brushes")) {
+			brushes = true;
+		} else if(!strcmp(argv[k], "--overdraw")) {
+			overdraw = true;
+		} else if(!strcmp(argv[k], "--unordered")) {
+			unordered = true;
+		} else if(!strcmp(argv[k], "--raycast")) {
+			raycast = true;
+		} else if(argv[k][0] != '-') {
+			project = argv[k];
+		} else {
+			printf("unknown option %s\n", argv[k]);
+			return 1;
+		}
+	}
+
+	if(frames < 3 || width <= 0 || height <= 0) {
+		printf("need at least 3 frames and a positive size\n");
+		return 1;
+	}
+
+	Uint64 start = SDL_GetPerformanceCounter();
+	size_t count;
+	struct layer* layers = project ? bench_load_project(project, &count) :
+									 bench_generate_project(&count);
+
+	if(!layers) {
+		printf("could not load project %s\n", project);
+		return 1;
+	}
+
+	double load_ms = bench_ms(start);
+
+	if(brushes || raycast) {
+		printf("project:  %s, loaded in %.1f ms\n",
+			   project ? project : "generated", load_ms);
+		bool success = true;
+
+		if(brushes)
+			bench_brushes(layers);
+		else
+			success = bench_raycast(layers, count, path, frames, width,
+									height, dump);
+
+		for(size_t k = 0; k < count; k++)
+			layer_destroy(layers + k);
+
+		free(layers);
+		pager_destroy();
+		thread_pool_destroy();
+
+		return success ? 0 : 1;
+	}
+
+	if(!bench_init_egl()) {
+		printf("could not create EGL context: 0x%x\n", eglGetError());
+		return 1;
+	}
+
+	if(!bench_init_framebuffer(width, height)) {
+		printf("could not create %dx%d framebuffer\n", width, height);
+		return 1;
+	}
+
+	bench_init_timer();
+
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+	glFrontFace(GL_CW);
+	glDepthFunc(GL_LEQUAL);
+	glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
+
+	bool success = render_init();
+	assert(success);
+
+	glUseProgram(render_program());
+	layer_render_ordered(!unordered);
+
+	if(overdraw && !bench.rgba8) {
+		printf("overdraw needs an 8 bit color buffer, not counted\n");
+		overdraw = false;
+	}
+
+	size_t keys_length;
+	struct bench_key* keys = path ? bench_load_path(path, &keys_length) :
+									bench_default_path(&keys_length);
+
+	if(!keys) {
+		printf("could not load camera path %s\n", path);
+		return 1;
+	}
+
+	printf("renderer: %s\n", glGetString(GL_RENDERER));
+	printf("project:  %s, %zu layers, loaded in %.1f ms\n",
+		   project ? project : "generated", count, load_ms);
+	printf("frames:   %zu at %dx%d, %zu key frames\n", frames, width, height,
+		   keys_length);
+
+	struct bench_frame* results = malloc(frames * sizeof(struct bench_frame));
+	assert(results);
+
+	for(size_t frame = 0; frame < frames; frame++) {
+		struct camera camera;
+		bench_camera(keys, keys_length, (float)frame / (frames - 1), &camera);
+
+		mat4 mvp;
+		camera_matrix(&camera, (float)width / height, mvp);
+
+		struct render_stats before, after;
+		render_stats(&before);
+
+		if(bench.timer.supported)
+			bench.timer.begin(GL_TIME_ELAPSED_EXT, bench.timer.query);
+
+		Uint64 frame_start = SDL_GetPerformanceCounter();
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		render_set_mvp(mvp);
+
+		for(size_t k = 0; k < count; k++)
+			layer_render(layers + k, mvp);
+
+		results[frame].cpu_ms = bench_ms(frame_start);
+
+		if(bench.timer.supported)
+			bench.timer.end(GL_TIME_ELAPSED_EXT);
+
+		glFinish();
+		results[frame].frame_ms = bench_ms(frame_start);
+		results[frame].gpu_ms = 0.0;
+
+		if(bench.timer.supported) {
+			GLuint64 elapsed;
+			GLint disjoint = 0;
+			bench.timer.result(bench.timer.query, GL_QUERY_RESULT_EXT,
+							   &elapsed);
+			glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+			results[frame].gpu_ms = disjoint ? NAN : elapsed / 1e6;
+		}
+
+		render_stats(&after);
+		results[frame].render = (struct render_stats) {
+			.draw_calls = after.draw_calls - before.draw_calls,
+			.quads = after.quads - before.quads,
+			.uploads = after.uploads - before.uploads,
+			.uploaded_bytes = after.uploaded_bytes - before.uploaded_bytes,
+		};
+
+		if(dump)
+			bench_dump(dump, frame);
+
+		if(overdraw) {
+			for(int k = 0; k < 2; k++) {
+				bench_overdraw(layers, count, mvp, k == 0,
+							   results[frame].fragments + k,
+							   results[frame].pixels + k);
+			}
+
+			layer_render_ordered(!unordered);
+		}
+
+		// later frames upload the baked light and draw with it
+		if(frame == 0)
+			light_wait();
+
+		pager_collect();
+	}
+
+	// the first frame meshes and uploads every chunk and queues its bake,
+	// the second uploads the baked ones, report them on their own
+	struct light_stats light;
+	light_stats(&light);
+
+	printf("first frame: %.3f ms cpu, %.3f ms total, %zu draw calls, %zu "
+		   "uploads, %.1f KiB uploaded\n",
+		   results[0].cpu_ms, results[0].frame_ms,
+		   results[0].render.draw_calls, results[0].render.uploads,
+		   results[0].render.uploaded_bytes / 1024.0);
+	printf("light bake:  %zu chunks, %.3f ms per chunk (max %.3f ms), %.3f ms "
+		   "until done\n",
+		   light.chunks, light.chunks ? light.chunk_ms / light.chunks : 0.0,
+		   light.max_chunk_ms, light.last_ms);
+	printf("second frame: %.3f ms cpu, %.3f ms total, %zu uploads, %.1f KiB "
+		   "uploaded\n",
+		   results[1].cpu_ms, results[1].frame_ms, results[1].render.uploads,
+		   results[1].render.uploaded_bytes / 1024.0);
+
+	size_t steady = frames - 2;
+	double* values = malloc(steady * sizeof(double));
+	assert(values);
+
+	size_t draw_calls = 0, quads = 0, uploaded = 0;
+
+	for(size_t k = 0; k < steady; k++) {
+		draw_calls += results[k + 2].render.draw_calls;
+		quads += results[k + 2].render.quads;
+		uploaded += results[k + 2].render.uploaded_bytes;
+	}
+
+	printf("per frame:   %.1f draw calls, %.0f quads, %.1f KiB uploaded\n",
+		   (double)draw_calls / steady, (double)quads / steady,
+		   uploaded / 1024.0 / steady);
+
+	if(overdraw) {
+		size_t fragments[2] = {0}, pixels[2] = {0};
+
+		for(size_t k = 0; k < steady; k++) {
+			for(int order = 0; order < 2; order++) {
+				fragments[order] += results[k + 2].fragments[order];
+				pixels[order] += results[k + 2].pixels[order];
+			}
+		}
+
+		const char* names[2] = {"front to back", "unordered"};
+
+		for(int order = 0; order < 2; order++) {
+			printf("overdraw:    %-13s %.2f fragments per covered pixel, "
+				   "%.2f M per frame\n",
+				   names[order],
+				   pixels[order] ? (double)fragments[order] / pixels[order] :
+								   0.0,
+				   fragments[order] / 1e6 / steady);
+		}
+	}
+
+	for(size_t k = 0; k < steady; k++)
+		values[k] = results[k + 2].cpu_ms;
+
+	bench_report("cpu", values, steady);
+
+	for(size_t k = 0; k < steady; k++)
+		values[k] = results[k + 2].frame_ms;
+
+	bench_report("frame", values, steady);
+
+	if(bench.timer.supported) {
+		size_t valid = 0;
+
+		for(size_t k = 0; k < steady; k++) {
+			if(!isnan(results[k + 2].gpu_ms))
+				values[valid++] = results[k + 2].gpu_ms;
+		}
+
+		bench_report("gpu", values, valid);
+	} else {
+		printf("gpu        timer queries not supported\n");
+	}
+
+	bench_report_pager();
+
+	free(values);
+	free(results);
+	free(keys);
+
+	for(size_t k = 0; k < count; k++)
+		layer_destroy(layers + k);
+
+	free(layers);
+
+	bool lit = bench_check_light();
+
+	pager_destroy();
+	render_destroy();
+	thread_pool_destroy();
+	bench_destroy();
+
+	return lit ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "blend.h"
+
+// mixes the constant colors a and b, ignoring the block color
+#define BLEND_GRADIENT 3
+
+// a * b / 255 rounded to nearest, exact for all 8 bit inputs
+static inline int blend_mul(int a, int b) {
+	int x = a * b + 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static inline uint8_t blend_channel(int op, int value, int a, int b,
+									int weight) {
+	int target;
+
+	switch(op) {
+		case BLEND_MULTIPLY: target = blend_mul(value, b); break;
+		case BLEND_SCREEN:
+			target = 255 - blend_mul(255 - value, 255 - b);
+			break;
+		case BLEND_GRADIENT:
+			value = a;
+			target = b;
+			break;
+		default: target = b;
+	}
+
+	return (value * (BLEND_ONE - weight) + target * weight + 128) >> 8;
+}
+
+static void blend_run_scalar(struct layer_chunk_block* row, size_t length,
+							 int op, struct color a, struct color b,
+							 const uint16_t* weights) {
+	for(size_t k = 0; k < length; k++) {
+		struct color* c = &row[k].color;
+
+		if(!row[k].solid)
+			continue;
+
+		*c = (struct color) {
+			.red = blend_channel(op, c->red, a.red, b.red, weights[k]),
+			.green = blend_channel(op, c->green, a.green, b.green, weights[k]),
+			.blue = blend_channel(op, c->blue, a.blue, b.blue, weights[k]),
+		};
+	}
+}
+
+#if defined(__SSE2__) || defined(__AVX2__)
+// a block in a 32 bit lane, the solid flag is the lowest byte
+static int blend_pack(struct color c) {
+	return (int)((uint32_t)c.red << 8 | (uint32_t)c.green << 16
+				 | (uint32_t)c.blue << 24);
+}
+#endif
+
+#if defined(__AVX2__)
+// the same steps as blend_channel(), 16 bit lanes hold channels of 4 blocks
+static inline __m256i blend_mul_avx2(__m256i a, __m256i b) {
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(a, b),
+								 _mm256_set1_epi16(128));
+	return _mm256_mulhi_epu16(x, _mm256_set1_epi16(257));
+}
+
+static inline __m256i blend_channels_avx2(int op, __m256i value, __m256i a,
+										  __m256i b, __m256i weight) {
+	__m256i max = _mm256_set1_epi16(255);
+	__m256i target;
+
+	switch(op) {
+		case BLEND_MULTIPLY: target = blend_mul_avx2(value, b); break;
+		case BLEND_SCREEN:
+			target = _mm256_sub_epi16(
+				max,
+				blend_mul_avx2(_mm256_sub_epi16(max, value),
+							   _mm256_sub_epi16(max, b)));
+			break;
+		case BLEND_GRADIENT:
+			value = a;
+			target = b;
+			break;
+		default: target = b;
+	}
+
+	__m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(BLEND_ONE), weight);
+	__m256i x = _mm256_add_epi16(_mm256_mullo_epi16(value, inverse),
+								 _mm256_mullo_epi16(target, weight));
+	return _mm256_srli_epi16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), 8);
+}
+
+// returns the number of blocks done, the rest is left to the scalar code
+static size_t blend_run_simd(struct layer_chunk_block* row, size_t length,
+							 int op, struct color a, struct color b,
+							 const uint16_t* weights) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i solid = _mm256_set1_epi32(0xFF);
+	__m256i va = _mm256_unpacklo_epi8(_mm256_set1_epi32(blend_pack(a)), zero);
+	__m256i vb = _mm256_unpacklo_epi8(_mm256_set1_epi32(blend_pack(b)), zero);
+	size_t k = 0;
+
+	for(; k + 8 <= length; k += 8) {
+		__m256i blocks = _mm256_loadu_si256((const __m256i*)(row + k));
+		__m128i w = _mm_loadu_si128((const __m128i*)(weights + k));
+
+		// unpacking works within 128 bit halves, blocks 0, 1, 4, 5 go low
+		__m256i w2 = _mm256_inserti128_si256(
+			_mm256_castsi128_si256(_mm_unpacklo_epi16(w, w)),
+			_mm_unpackhi_epi16(w, w), 1);
+
+		__m256i lo = blend_channels_avx2(op, _mm256_unpacklo_epi8(blocks, zero),
+										 va, vb, _mm256_unpacklo_epi32(w2, w2));
+		__m256i hi = blend_channels_avx2(op, _mm256_unpackhi_epi8(blocks, zero),
+										 va, vb, _mm256_unpackhi_epi32(w2, w2));
+
+		// keeps the solid flag and air blocks as they are
+		__m256i keep = _mm256_or_si256(
+			_mm256_cmpeq_epi32(_mm256_and_si256(blocks, solid), zero), solid);
+		__m256i result = _mm256_or_si256(
+			_mm256_and_si256(keep, blocks),
+			_mm256_andnot_si256(keep, _mm256_packus_epi16(lo, hi)));
+
+		_mm256_storeu_si256((__m256i*)(row + k), result);
+	}
+
+	return k;
+}
+#elif defined(__SSE2__)
+// the same steps as blend_channel(), 16 bit lanes hold channels of 2 blocks
+static inline __m128i blend_mul_sse2(__m128i a, __m128i b) {
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+	return _mm_mulhi_epu16(x, _mm_set1_epi16(257));
+}
+
+static inline __m128i blend_channels_sse2(int op, __m128i value, __m128i a,
+										  __m128i b, __m128i weight) {
+	__m128i max = _mm_set1_epi16(255);
+	__m128i target;
+
+	switch(op) {
+		case BLEND_MULTIPLY: target = blend_mul_sse2(value, b); break;
+		case BLEND_SCREEN:
+			target = _mm_sub_epi16(max,
+								   blend_mul_sse2(_mm_sub_epi16(max, value),
+												  _mm_sub_epi16(max, b)));
+			break;
+		case BLEND_GRADIENT:
+			value = a;
+			target = b;
+			break;
+		default: target = b;
+	}
+
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(BLEND_ONE), weight);
+	__m128i x = _mm_add_epi16(_mm_mullo_epi16(value, inverse),
+							  _mm_mullo_epi16(target, weight));
+	return _mm_srli_epi16(_mm_add_epi16(x, _mm_set1_epi16(128)), 8);
+}
+
+// returns the number of blocks done, the rest is left to the scalar code
+static size_t blend_run_simd(struct layer_chunk_block* row, size_t length,
+							 int op, struct color a, struct color b,
+							 const uint16_t* weights) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i solid = _mm_set1_epi32(0xFF);
+	__m128i va = _mm_unpacklo_epi8(_mm_set1_epi32(blend_pack(a)), zero);
+	__m128i vb = _mm_unpacklo_epi8(_mm_set1_epi32(blend_pack(b)), zero);
+	size_t k = 0;
+
+	for(; k + 4 <= length; k += 4) {
+		__m128i blocks = _mm_loadu_si128((const __m128i*)(row + k));
+		__m128i w = _mm_loadl_epi64((const __m128i*)(weights + k));
+		w = _mm_unpacklo_epi16(w, w);
+
+		__m128i lo = blend_channels_sse2(op, _mm_unpacklo_epi8(blocks, zero),
+										 va, vb, _mm_unpacklo_epi32(w, w));
+		__m128i hi = blend_channels_sse2(op, _mm_unpackhi_epi8(blocks, zero),
+										 va, vb, _mm_unpackhi_epi32(w, w));
+
+		// keeps the solid flag and air blocks as they are
+		__m128i keep = _mm_or_si128(
+			_mm_cmpeq_epi32(_mm_and_si128(blocks, solid), zero), solid);
+		__m128i result
+			= _mm_or_si128(_mm_and_si128(keep, blocks),
+						   _mm_andnot_si128(keep, _mm_packus_epi16(lo, hi)));
+
+		_mm_storeu_si128((__m128i*)(row + k), result);
+	}
+
+	return k;
+}
+#endif
+
+static void blend_run(struct layer_chunk_block* row, size_t length, int op,
+					  struct color a, struct color b,
+					  const uint16_t* weights) {
+	// the vector code loads blocks as 32 bit words
+	assert(sizeof(struct layer_chunk_block) == 4);
+
+	size_t k = 0;
+
+#if defined(__SSE2__) || defined(__AVX2__)
+	k = blend_run_simd(row, length, op, a, b, weights);
+#endif
+
+	blend_run_scalar(row + k, length - k, op, a, b, weights + k);
+}
+
+void blend_row(struct layer_chunk_block* row, size_t length, enum blend_op op,
+			   struct color color, const uint16_t* weights) {
+	assert(row && weights);
+	assert(op == BLEND_LERP || op == BLEND_MULTIPLY || op == BLEND_SCREEN);
+
+	blend_run(row, length, op, color, color, weights);
+}
+
+void blend_gradient_row(struct layer_chunk_block* row, size_t length,
+						struct color a, struct color b, const uint16_t* t) {
+	assert(row && t);
+	blend_run(row, length, BLEND_GRADIENT, a, b, t);
+}
@@ -0,0 +1,53 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_BLEND_H
+#define PINKED_BLEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "payload.h"
+
+// weights are fixed-point from 0 to BLEND_ONE
+#define BLEND_ONE 256
+
+enum blend_op {
+	BLEND_LERP = 0,
+	BLEND_MULTIPLY = 1,
+	BLEND_SCREEN = 2,
+};
+
+/*
+	Kernels over consecutive blocks of a chunk, e.g. a row along x. Every
+	solid block is mixed with the result of the operation by its weight,
+	0 keeps the block and BLEND_ONE applies the operation fully. Air blocks
+	are never changed.
+
+	Uses AVX2 or SSE2 if the compiler targets them, all variants give the
+	same result. Thread-safe, blocks must not be shared payloads.
+*/
+void blend_row(struct layer_chunk_block* row, size_t length, enum blend_op op,
+			   struct color color, const uint16_t* weights);
+// solid blocks are set to the color between a and b at t
+void blend_gradient_row(struct layer_chunk_block* row, size_t length,
+						struct color a, struct color b, const uint16_t* t);
+
+#endif
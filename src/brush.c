@@ -0,0 +1,574 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdlib.h>
+
+#include "brush.h"
+#include "pager.h"
+#include "thread_pool.h"
+
+struct brush;
+
+// x, y, z is the voxel of the first block of the row
+typedef void (*brush_row)(struct brush* b, struct layer_chunk_block* row,
+						  size_t length, int x, int y, int z);
+
+struct brush_chunk {
+	struct layer_chunk* chunk;
+	struct layer_chunk_block* blocks;
+	// part of the box inside the chunk, inclusive local coordinates
+	int lo[3], hi[3];
+};
+
+struct brush {
+	brush_row row;
+	int min[3], max[3];
+	struct brush_chunk* chunks;
+	size_t length, capacity;
+
+	enum blend_op blend;
+	struct color a, b;
+	uint16_t amount;
+	uint16_t weights[LAYER_CHUNK_SIZE];
+	vec3 origin;
+	// direction of linear gradients divided by their squared length
+	vec3 axis;
+	float radius;
+
+	// half width of the shape in row y, z around origin, negative if none
+	float (*half)(struct brush* b, int y, int z);
+	vec3 radii;
+	float height;
+	enum edit_op edit;
+	// inclusive span along x of each row of the box, empty if lo > hi
+	int* spans;
+};
+
+static void brush_add_chunk(struct brush* b, struct layer_chunk* c) {
+	int pos[3] = {c->x, c->y, c->z};
+	struct brush_chunk bc = {.chunk = c};
+
+	for(int k = 0; k < 3; k++) {
+		int base = pos[k] * LAYER_CHUNK_SIZE;
+
+		if(b->max[k] < base || b->min[k] >= base + LAYER_CHUNK_SIZE)
+			return;
+
+		bc.lo[k] = (b->min[k] > base) ? b->min[k] - base : 0;
+		bc.hi[k] = (b->max[k] < base + LAYER_CHUNK_SIZE - 1) ?
+			b->max[k] - base :
+			LAYER_CHUNK_SIZE - 1;
+	}
+
+	if(b->length == b->capacity) {
+		b->capacity = b->capacity ? b->capacity * 2 : 64;
+		b->chunks = realloc(b->chunks, b->capacity * sizeof(*b->chunks));
+		assert(b->chunks);
+	}
+
+	pager_touch(c);
+	bc.blocks = layer_chunk_edit_begin(c);
+	b->chunks[b->length++] = bc;
+}
+
+static bool brush_collect_callback(void* key, void* value, void* user) {
+	brush_add_chunk((struct brush*)user, (struct layer_chunk*)value);
+	return true;
+}
+
+// bulk edits count their chunks before and after changing them
+static void brush_count(struct brush* b, struct layer* l, int sign) {
+	struct layer_chunk** chunks = malloc(b->length * sizeof(*chunks));
+	assert(chunks || !b->length);
+
+	for(size_t k = 0; k < b->length; k++)
+		chunks[k] = b->chunks[k].chunk;
+
+	layer_count_chunks(l, chunks, b->length, sign);
+	free(chunks);
+}
+
+static void brush_apply_chunk(size_t job, void* user) {
+	struct brush* b = (struct brush*)user;
+	struct brush_chunk* bc = b->chunks + job;
+	int base[3] = {
+		bc->chunk->x * LAYER_CHUNK_SIZE,
+		bc->chunk->y * LAYER_CHUNK_SIZE,
+		bc->chunk->z * LAYER_CHUNK_SIZE,
+	};
+
+	for(int z = bc->lo[2]; z <= bc->hi[2]; z++) {
+		for(int y = bc->lo[1]; y <= bc->hi[1]; y++)
+			b->row(b, bc->blocks + LAYER_CHUNK_INDEX(bc->lo[0], y, z),
+				   bc->hi[0] - bc->lo[0] + 1, base[0] + bc->lo[0],
+				   base[1] + y, base[2] + z);
+	}
+}
+
+static void brush_apply(struct brush* b, struct layer* l) {
+	assert(b->min[0] <= b->max[0] && b->min[1] <= b->max[1]
+		   && b->min[2] <= b->max[2]);
+
+	double range = 1.0;
+
+	for(int k = 0; k < 3; k++)
+		range *= LAYER_CHUNK_COORD(b->max[k]) - LAYER_CHUNK_COORD(b->min[k])
+			+ 1;
+
+	// large boxes over sparse layers are cheaper to filter than to look up
+	if(range > l->chunks.size) {
+		ht_iterate(&l->chunks, b, brush_collect_callback);
+	} else {
+		for(int z = LAYER_CHUNK_COORD(b->min[2]);
+			z <= LAYER_CHUNK_COORD(b->max[2]); z++) {
+			for(int y = LAYER_CHUNK_COORD(b->min[1]);
+				y <= LAYER_CHUNK_COORD(b->max[1]); y++) {
+				for(int x = LAYER_CHUNK_COORD(b->min[0]);
+					x <= LAYER_CHUNK_COORD(b->max[0]); x++) {
+					struct layer_chunk* c = layer_get_chunk(l, x, y, z, false);
+
+					if(c)
+						brush_add_chunk(b, c);
+				}
+			}
+		}
+	}
+
+	brush_count(b, l, -1);
+	thread_pool_run(b->length, brush_apply_chunk, b);
+	brush_count(b, l, 1);
+
+	for(size_t k = 0; k < b->length; k++)
+		layer_chunk_edit_end(b->chunks[k].chunk);
+
+	free(b->chunks);
+}
+
+static void brush_box(struct brush* b, int* min, int* max) {
+	for(int k = 0; k < 3; k++) {
+		b->min[k] = min[k];
+		b->max[k] = max[k];
+	}
+}
+
+static void brush_blend_row(struct brush* b, struct layer_chunk_block* row,
+							size_t length, int x, int y, int z) {
+	blend_row(row, length, b->blend, b->a, b->weights);
+}
+
+void brush_blend_box(struct layer* l, int* min, int* max, enum blend_op op,
+					 struct color color, uint16_t amount) {
+	assert(l && min && max && amount <= BLEND_ONE);
+
+	struct brush b = {
+		.row = brush_blend_row,
+		.blend = op,
+		.a = color,
+	};
+
+	brush_box(&b, min, max);
+
+	for(size_t k = 0; k < LAYER_CHUNK_SIZE; k++)
+		b.weights[k] = amount;
+
+	brush_apply(&b, l);
+}
+
+static void brush_blend_sphere_row(struct brush* b,
+								   struct layer_chunk_block* row,
+								   size_t length, int x, int y, int z) {
+	uint16_t weights[LAYER_CHUNK_SIZE];
+	float dy = y - b->origin[1];
+	float dz = z - b->origin[2];
+
+	for(size_t k = 0; k < length; k++) {
+		float dx = x + (int)k - b->origin[0];
+		float d = sqrtf(dx * dx + dy * dy + dz * dz) / b->radius;
+		weights[k] = (d < 1.0F) ? (uint16_t)(b->amount * (1.0F - d) + 0.5F) : 0;
+	}
+
+	blend_row(row, length, b->blend, b->a, weights);
+}
+
+void brush_blend_sphere(struct layer* l, vec3 center, float radius,
+						enum blend_op op, struct color color, uint16_t amount) {
+	assert(l && center && radius > 0.0F && amount <= BLEND_ONE);
+
+	struct brush b = {
+		.row = brush_blend_sphere_row,
+		.blend = op,
+		.a = color,
+		.amount = amount,
+		.radius = radius,
+	};
+
+	glm_vec3_copy(center, b.origin);
+
+	for(int k = 0; k < 3; k++) {
+		b.min[k] = (int)floorf(center[k] - radius);
+		b.max[k] = (int)ceilf(center[k] + radius);
+	}
+
+	brush_apply(&b, l);
+}
+
+static uint16_t brush_weight(float t) {
+	return (uint16_t)(glm_clamp(t, 0.0F, 1.0F) * BLEND_ONE + 0.5F);
+}
+
+static void brush_linear_row(struct brush* b, struct layer_chunk_block* row,
+							 size_t length, int x, int y, int z) {
+	uint16_t t[LAYER_CHUNK_SIZE];
+	float start = (x - b->origin[0]) * b->axis[0]
+		+ (y - b->origin[1]) * b->axis[1] + (z - b->origin[2]) * b->axis[2];
+
+	for(size_t k = 0; k < length; k++)
+		t[k] = brush_weight(start + k * b->axis[0]);
+
+	blend_gradient_row(row, length, b->a, b->b, t);
+}
+
+void brush_gradient_linear(struct layer* l, int* min, int* max, vec3 from,
+						   vec3 to, struct color a, struct color b) {
+	assert(l && min && max && from && to);
+
+	struct brush br = {
+		.row = brush_linear_row,
+		.a = a,
+		.b = b,
+	};
+
+	brush_box(&br, min, max);
+	glm_vec3_copy(from, br.origin);
+	glm_vec3_sub(to, from, br.axis);
+
+	float length = glm_vec3_norm2(br.axis);
+	assert(length > 0.0F);
+	glm_vec3_scale(br.axis, 1.0F / length, br.axis);
+
+	brush_apply(&br, l);
+}
+
+static void brush_radial_row(struct brush* b, struct layer_chunk_block* row,
+							 size_t length, int x, int y, int z) {
+	uint16_t t[LAYER_CHUNK_SIZE];
+	float dy = y - b->origin[1];
+	float dz = z - b->origin[2];
+
+	for(size_t k = 0; k < length; k++) {
+		float dx = x + (int)k - b->origin[0];
+		t[k] = brush_weight(sqrtf(dx * dx + dy * dy + dz * dz) / b->radius);
+	}
+
+	blend_gradient_row(row, length, b->a, b->b, t);
+}
+
+void brush_gradient_radial(struct layer* l, int* min, int* max, vec3 center,
+						   float radius, struct color a, struct color b) {
+	assert(l && min && max && center && radius > 0.0F);
+
+	struct brush br = {
+		.row = brush_radial_row,
+		.a = a,
+		.b = b,
+		.radius = radius,
+	};
+
+	brush_box(&br, min, max);
+	glm_vec3_copy(center, br.origin);
+
+	brush_apply(&br, l);
+}
+
+static int* brush_span(struct brush* b, int y, int z) {
+	size_t rows = b->max[1] - b->min[1] + 1;
+	return b->spans + ((z - b->min[2]) * rows + (y - b->min[1])) * 2;
+}
+
+static void brush_spans(struct brush* b) {
+	size_t rows
+		= (size_t)(b->max[1] - b->min[1] + 1) * (b->max[2] - b->min[2] + 1);
+	b->spans = malloc(rows * 2 * sizeof(int));
+	assert(b->spans);
+
+	for(int z = b->min[2]; z <= b->max[2]; z++) {
+		for(int y = b->min[1]; y <= b->max[1]; y++) {
+			int* span = brush_span(b, y, z);
+			float half = b->half(b, y, z);
+
+			if(half >= 0.0F) {
+				span[0] = fmaxf(ceilf(b->origin[0] - half), b->min[0]);
+				span[1] = fminf(floorf(b->origin[0] + half), b->max[0]);
+			} else {
+				span[0] = 1;
+				span[1] = 0;
+			}
+		}
+	}
+}
+
+// x range covered by any row of a column of chunks and by all of them
+static void brush_cover(struct brush* b, int y, int z, int* any, int* all) {
+	any[0] = all[1] = INT_MAX;
+	any[1] = all[0] = INT_MIN;
+
+	bool complete = true;
+
+	for(int lz = 0; lz < LAYER_CHUNK_SIZE; lz++) {
+		for(int ly = 0; ly < LAYER_CHUNK_SIZE; ly++) {
+			int wy = y * LAYER_CHUNK_SIZE + ly;
+			int wz = z * LAYER_CHUNK_SIZE + lz;
+
+			if(wy < b->min[1] || wy > b->max[1] || wz < b->min[2]
+			   || wz > b->max[2]) {
+				complete = false;
+				continue;
+			}
+
+			int* span = brush_span(b, wy, wz);
+
+			if(span[0] > span[1]) {
+				complete = false;
+				continue;
+			}
+
+			if(span[0] < any[0])
+				any[0] = span[0];
+
+			if(span[1] > any[1])
+				any[1] = span[1];
+
+			if(span[0] > all[0])
+				all[0] = span[0];
+
+			if(span[1] < all[1])
+				all[1] = span[1];
+		}
+	}
+
+	if(!complete) {
+		all[0] = INT_MAX;
+		all[1] = INT_MIN;
+	}
+}
+
+static void brush_span_chunk(size_t job, void* user) {
+	struct brush* b = (struct brush*)user;
+	struct brush_chunk* bc = b->chunks + job;
+	struct layer_chunk* c = bc->chunk;
+	struct layer_chunk_block solid = {.solid = true, .color = b->a};
+	struct layer_chunk_block air = {.solid = false};
+	int base = c->x * LAYER_CHUNK_SIZE;
+	size_t added = 0, removed = 0;
+
+	for(int z = bc->lo[2]; z <= bc->hi[2]; z++) {
+		for(int y = bc->lo[1]; y <= bc->hi[1]; y++) {
+			int* span = brush_span(b, c->y * LAYER_CHUNK_SIZE + y,
+								   c->z * LAYER_CHUNK_SIZE + z);
+			int lo = span[0] - base;
+			int hi = span[1] - base;
+
+			if(lo < 0)
+				lo = 0;
+
+			if(hi > LAYER_CHUNK_SIZE - 1)
+				hi = LAYER_CHUNK_SIZE - 1;
+
+			struct layer_chunk_block* row
+				= bc->blocks + LAYER_CHUNK_INDEX(0, y, z);
+
+			for(int x = lo; x <= hi; x++) {
+				if(b->edit == EDIT_SOLID) {
+					added += !row[x].solid;
+					row[x] = solid;
+				} else {
+					removed += row[x].solid;
+					row[x] = air;
+				}
+			}
+		}
+	}
+
+	c->solid_blocks = c->solid_blocks + added - removed;
+}
+
+static void brush_shape(struct brush* b, struct layer* l) {
+	// too small to contain any voxel
+	if(b->min[0] > b->max[0] || b->min[1] > b->max[1] || b->min[2] > b->max[2])
+		return;
+
+	brush_spans(b);
+
+	// shared by all chunks entirely inside
+	struct layer_chunk_payload* full = NULL;
+
+	if(b->edit == EDIT_SOLID) {
+		full = payload_create();
+
+		for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++)
+			full->blocks[k] = (struct layer_chunk_block) {
+				.solid = true,
+				.color = b->a,
+			};
+
+		full = payload_share(full);
+	}
+
+	for(int z = LAYER_CHUNK_COORD(b->min[2]); z <= LAYER_CHUNK_COORD(b->max[2]);
+		z++) {
+		for(int y = LAYER_CHUNK_COORD(b->min[1]);
+			y <= LAYER_CHUNK_COORD(b->max[1]); y++) {
+			int any[2], all[2];
+			brush_cover(b, y, z, any, all);
+
+			if(any[0] > any[1])
+				continue;
+
+			for(int x = LAYER_CHUNK_COORD(any[0]);
+				x <= LAYER_CHUNK_COORD(any[1]); x++) {
+				int base = x * LAYER_CHUNK_SIZE;
+				struct layer_chunk* c
+					= layer_get_chunk(l, x, y, z, b->edit == EDIT_SOLID);
+
+				if(!c)
+					continue;
+
+				if(all[0] > base || all[1] < base + LAYER_CHUNK_SIZE - 1) {
+					brush_add_chunk(b, c);
+				} else if(full) {
+					layer_chunk_replace(c, payload_ref(full),
+										LAYER_CHUNK_VOLUME);
+				} else {
+					layer_remove_chunk(l, c);
+				}
+			}
+		}
+	}
+
+	brush_count(b, l, -1);
+	thread_pool_run(b->length, brush_span_chunk, b);
+	brush_count(b, l, 1);
+
+	for(size_t k = 0; k < b->length; k++) {
+		layer_chunk_edit_end(b->chunks[k].chunk);
+
+		if(!b->chunks[k].chunk->solid_blocks)
+			layer_remove_chunk(l, b->chunks[k].chunk);
+	}
+
+	if(full)
+		payload_unref(full);
+
+	free(b->spans);
+	free(b->chunks);
+}
+
+static float brush_ellipsoid_half(struct brush* b, int y, int z) {
+	float dy = (y - b->origin[1]) / b->radii[1];
+	float dz = (z - b->origin[2]) / b->radii[2];
+	float q = 1.0F - dy * dy - dz * dz;
+
+	return (q >= 0.0F) ? b->radii[0] * sqrtf(q) : -1.0F;
+}
+
+void brush_ellipsoid(struct layer* l, vec3 center, vec3 radii,
+					 enum edit_op op, struct color color) {
+	assert(l && center && radii);
+	assert(radii[0] > 0.0F && radii[1] > 0.0F && radii[2] > 0.0F);
+
+	struct brush b = {
+		.half = brush_ellipsoid_half,
+		.edit = op,
+		.a = color,
+	};
+
+	glm_vec3_copy(center, b.origin);
+	glm_vec3_copy(radii, b.radii);
+
+	for(int k = 0; k < 3; k++) {
+		b.min[k] = (int)ceilf(center[k] - radii[k]);
+		b.max[k] = (int)floorf(center[k] + radii[k]);
+	}
+
+	brush_shape(&b, l);
+}
+
+void brush_sphere(struct layer* l, vec3 center, float radius, enum edit_op op,
+				  struct color color) {
+	brush_ellipsoid(l, center, (vec3) {radius, radius, radius}, op, color);
+}
+
+static float brush_cylinder_half(struct brush* b, int y, int z) {
+	float dy = y - b->origin[1];
+	float q = b->radius * b->radius - dy * dy;
+
+	return (q >= 0.0F) ? sqrtf(q) : -1.0F;
+}
+
+static float brush_cone_half(struct brush* b, int y, int z) {
+	float dy = y - b->origin[1];
+	float radius = b->radius * (1.0F - (z - b->origin[2]) / b->height);
+	float q = radius * radius - dy * dy;
+
+	return (radius >= 0.0F && q >= 0.0F) ? sqrtf(q) : -1.0F;
+}
+
+static void brush_upright(struct brush* b, struct layer* l, vec3 base,
+						  float radius, float height) {
+	assert(l && base && radius > 0.0F && height > 0.0F);
+
+	glm_vec3_copy(base, b->origin);
+	b->radius = radius;
+	b->height = height;
+
+	for(int k = 0; k < 2; k++) {
+		b->min[k] = (int)ceilf(base[k] - radius);
+		b->max[k] = (int)floorf(base[k] + radius);
+	}
+
+	b->min[2] = (int)ceilf(base[2]);
+	b->max[2] = (int)floorf(base[2] + height);
+
+	brush_shape(b, l);
+}
+
+void brush_cylinder(struct layer* l, vec3 base, float radius, float height,
+					enum edit_op op, struct color color) {
+	struct brush b = {
+		.half = brush_cylinder_half,
+		.edit = op,
+		.a = color,
+	};
+
+	brush_upright(&b, l, base, radius, height);
+}
+
+void brush_cone(struct layer* l, vec3 base, float radius, float height,
+				enum edit_op op, struct color color) {
+	struct brush b = {
+		.half = brush_cone_half,
+		.edit = op,
+		.a = color,
+	};
+
+	brush_upright(&b, l, base, radius, height);
+}
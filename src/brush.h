@@ -0,0 +1,70 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_BRUSH_H
+#define PINKED_BRUSH_H
+
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "blend.h"
+#include "color.h"
+#include "edit_batch.h"
+#include "layer.h"
+
+/*
+	Blend brushes recolor solid voxels of a layer, they never add or remove
+	any. Boxes are inclusive minimum and maximum voxel coordinates, amounts
+	are weights of blend.h. Every chunk touched is edited at once on the
+	thread pool, row by row along x.
+*/
+void brush_blend_box(struct layer* l, int* min, int* max, enum blend_op op,
+					 struct color color, uint16_t amount);
+// full amount at the center, fading out towards the radius
+void brush_blend_sphere(struct layer* l, vec3 center, float radius,
+						enum blend_op op, struct color color, uint16_t amount);
+
+// color a at from to color b at to, constant beyond both ends
+void brush_gradient_linear(struct layer* l, int* min, int* max, vec3 from,
+						   vec3 to, struct color a, struct color b);
+// color a at the center to color b at the radius and beyond
+void brush_gradient_radial(struct layer* l, int* min, int* max, vec3 center,
+						   float radius, struct color a, struct color b);
+
+/*
+	Shape brushes fill voxels with a color or turn them into air. The span
+	of each row along x is solved analytically. Chunks outside the shape
+	are skipped, chunks entirely inside reference one shared payload or are
+	removed, the others are written span by span on the thread pool. Each
+	changed chunk is marked dirty once.
+
+	A voxel is inside if its coordinates are. Cylinders and cones stand
+	upright on the center of their base, cones end in a point at the top.
+*/
+void brush_sphere(struct layer* l, vec3 center, float radius, enum edit_op op,
+				  struct color color);
+void brush_ellipsoid(struct layer* l, vec3 center, vec3 radii,
+					 enum edit_op op, struct color color);
+void brush_cylinder(struct layer* l, vec3 base, float radius, float height,
+					enum edit_op op, struct color color);
+void brush_cone(struct layer* l, vec3 base, float radius, float height,
+				enum edit_op op, struct color color);
+
+#endif
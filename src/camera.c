@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <math.h>
+
+#include "camera.h"
+
+#define CAMERA_PITCH_LIMIT glm_rad(89.0F)
+
+void camera_create(struct camera* c, float x, float y, float z) {
+	assert(c);
+
+	c->target[0] = x;
+	c->target[1] = y;
+	c->target[2] = z;
+	c->yaw = glm_rad(-135.0F);
+	c->pitch = glm_rad(35.0F);
+	c->distance = 128.0F;
+	c->fov = glm_rad(70.0F);
+}
+
+void camera_rotate(struct camera* c, float yaw, float pitch) {
+	assert(c);
+
+	c->yaw = fmodf(c->yaw + yaw, 2.0F * GLM_PI);
+	c->pitch = fmaxf(fminf(c->pitch + pitch, CAMERA_PITCH_LIMIT),
+					 -CAMERA_PITCH_LIMIT);
+}
+
+void camera_zoom(struct camera* c, float factor) {
+	assert(c && factor > 0.0F);
+	c->distance = fmaxf(fminf(c->distance * factor, 4096.0F), 1.0F);
+}
+
+void camera_move(struct camera* c, float forward, float right, float up) {
+	assert(c);
+
+	// view direction projected onto the ground
+	float dx = -cosf(c->yaw);
+	float dy = -sinf(c->yaw);
+
+	c->target[0] += dx * forward + dy * right;
+	c->target[1] += dy * forward - dx * right;
+	c->target[2] += up;
+}
+
+void camera_position(struct camera* c, vec3 position) {
+	assert(c && position);
+
+	position[0] = c->target[0] + c->distance * cosf(c->pitch) * cosf(c->yaw);
+	position[1] = c->target[1] + c->distance * cosf(c->pitch) * sinf(c->yaw);
+	position[2] = c->target[2] + c->distance * sinf(c->pitch);
+}
+
+void camera_matrix(struct camera* c, float aspect, mat4 mvp) {
+	assert(c && mvp && aspect > 0.0F);
+
+	vec3 position;
+	camera_position(c, position);
+
+	mat4 projection, view;
+	glm_perspective(c->fov, aspect, 0.5F, c->distance + 4096.0F, projection);
+	glm_lookat(position, c->target, (vec3) {0.0F, 0.0F, 1.0F}, view);
+	glm_mat4_mul(projection, view, mvp);
+}
@@ -0,0 +1,45 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_CAMERA_H
+#define PINKED_CAMERA_H
+
+#include <stdbool.h>
+
+#include <cglm/cglm.h>
+
+// orbits around a target, z is up
+struct camera {
+	vec3 target;
+	float yaw, pitch;
+	float distance;
+	float fov;
+};
+
+void camera_create(struct camera* c, float x, float y, float z);
+
+void camera_rotate(struct camera* c, float yaw, float pitch);
+void camera_zoom(struct camera* c, float factor);
+// moves the target relative to the current view direction
+void camera_move(struct camera* c, float forward, float right, float up);
+
+void camera_position(struct camera* c, vec3 position);
+void camera_matrix(struct camera* c, float aspect, mat4 mvp);
+
+#endif
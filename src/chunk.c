@@ -21,170 +21,587 @@
 #include <stdlib.h>
 
 #include "chunk.h"
+#include "light.h"
+#include "pager.h"
+#include "render.h"
 
-#define LAYER_CHUNK_INDEX(x, y, z)                                             \
-	((x) + ((y)*LAYER_CHUNK_SIZE + (z)) * LAYER_CHUNK_SIZE)
+#define LAYER_CHUNK_LOD_INDEX(x, y, z, level)                                  \
+	((x)                                                                       \
+	 + ((y)*LAYER_CHUNK_LOD_SIZE(level) + (z)) * LAYER_CHUNK_LOD_SIZE(level))
+
+static enum layer_chunk_lod_mode lod_mode = LOD_MAJORITY;
+static size_t changes = 0;
+
+void layer_chunk_set_lod_mode(enum layer_chunk_lod_mode mode) {
+	lod_mode = mode;
+}
+
+size_t layer_chunk_changes(void) {
+	return changes;
+}
 
 void layer_chunk_init(struct layer_chunk* c, int x, int y, int z) {
 	assert(c);
 
-	c->render.has_vbo = false;
-	c->render.vbo_dirty = true;
+	for(size_t k = 0; k < LAYER_CHUNK_LODS; k++) {
+		c->render[k].has_vbo = false;
+		c->render[k].vbo_dirty = true;
+		c->render[k].vertices = 0;
+	}
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS - 1; k++)
+		c->lod.blocks[k] = NULL;
+
+	for(size_t k = 0; k < LAYER_CHUNK_SIZE; k++)
+		c->light.columns[k] = 0;
+
+	c->light.changed = true;
+	c->light.dirty = true;
+	c->light.pending = false;
+	c->light.vertices = NULL;
+	c->light.quads = 0;
+	c->light.job = NULL;
+	c->light.queue = NULL;
+	c->light.queued = false;
+	c->lod.dirty = true;
+	c->lod.mode = lod_mode;
+	c->page.linked = false;
+	c->page.dirty = true;
+	c->page.offset = -1;
+	c->page.last_use = 0;
 	c->x = x;
 	c->y = y;
 	c->z = z;
 	c->solid_blocks = 0;
-	c->blocks = malloc(LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE
-					   * sizeof(struct layer_chunk_block));
-	assert(c->blocks);
+	c->stats.layer = NULL;
+	c->stats.payload = NULL;
+	c->stats.memory = 0;
+	c->stats.gpu_bytes = 0;
+	c->payload = payload_create();
+}
 
-	// don't feel like using memset() here
-	for(size_t k = 0;
-		k < LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE; k++)
-		c->blocks[k].solid = false;
+void layer_chunk_copy(struct layer_chunk* dst, struct layer_chunk* src) {
+	assert(dst && src);
+
+	layer_chunk_init(dst, src->x, src->y, src->z);
+	payload_unref(dst->payload);
+
+	layer_chunk_share(src);
+	dst->payload = payload_ref(src->payload);
+	dst->solid_blocks = src->solid_blocks;
 }
 
 void layer_chunk_destroy(struct layer_chunk* c) {
 	assert(c);
 
-	if(c->render.has_vbo)
-		glDeleteBuffers(1, &c->render.vbo);
+	pager_forget(c);
+	light_cancel(c);
+
+	// the last queued chunk takes its place
+	if(c->light.queued) {
+		struct layer_light* q = c->light.queue;
+		struct layer_chunk* last = q->queue[--q->queued];
+
+		q->queue[c->light.queue_index] = last;
+		last->light.queue_index = c->light.queue_index;
+		c->light.queued = false;
+	}
+
+	if(layer_chunk_resident(c))
+		layer_chunk_evict(c);
+}
+
+void layer_chunk_share(struct layer_chunk* c) {
+	assert(c && c->payload);
+	c->payload = payload_share(c->payload);
+	layer_chunk_account(c);
+}
+
+void layer_chunk_evict(struct layer_chunk* c) {
+	assert(c && c->payload);
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS; k++) {
+		if(c->render[k].has_vbo)
+			glDeleteBuffers(1, &c->render[k].vbo);
+
+		c->render[k].has_vbo = false;
+		c->render[k].vbo_dirty = true;
+		c->render[k].vertices = 0;
+	}
+
+	free(c->lod.blocks[0]);
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS - 1; k++)
+		c->lod.blocks[k] = NULL;
+
+	c->lod.dirty = true;
+
+	free(c->light.vertices);
+	c->light.vertices = NULL;
+	c->light.pending = false;
+	light_cancel(c);
+	// columns stay valid, they only depend on the blocks
+	c->light.dirty = true;
+
+	payload_unref(c->payload);
+	c->payload = NULL;
+
+	layer_chunk_account(c);
+}
+
+void layer_chunk_restore(struct layer_chunk* c,
+						 struct layer_chunk_payload* payload) {
+	assert(c && !c->payload && payload);
+	c->payload = payload;
+	layer_chunk_account(c);
+
+	// skipped by light_update() while it was evicted
+	if(c->light.dirty)
+		layer_chunk_queue_light(c);
+}
+
+bool layer_chunk_resident(struct layer_chunk* c) {
+	assert(c);
+	return c->payload != NULL;
+}
+
+// detail levels and meshes, owned by the chunk alone
+static size_t layer_chunk_own_memory(struct layer_chunk* c) {
+	size_t bytes = 0;
+
+	if(c->lod.blocks[0]) {
+		for(size_t k = 1; k < LAYER_CHUNK_LODS; k++)
+			bytes += LAYER_CHUNK_LOD_SIZE(k) * LAYER_CHUNK_LOD_SIZE(k)
+				* LAYER_CHUNK_LOD_SIZE(k) * sizeof(struct layer_chunk_block);
+	}
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS; k++)
+		bytes += c->render[k].vertices * sizeof(struct render_vertex);
+
+	if(c->light.pending)
+		bytes += c->light.quads * 4 * sizeof(struct render_vertex);
+
+	return bytes;
+}
+
+size_t layer_chunk_memory(struct layer_chunk* c) {
+	assert(c);
+
+	size_t bytes = layer_chunk_own_memory(c);
+
+	if(c->payload)
+		bytes += sizeof(struct layer_chunk_payload) / c->payload->references;
+
+	return bytes;
+}
+
+void layer_chunk_account(struct layer_chunk* c) {
+	assert(c);
+
+	struct stats* s = c->stats.layer;
+
+	if(!s)
+		return;
+
+	// shared payloads are counted once per layer, not split between the
+	// chunks as of their last change, which drifts as references change
+	if(c->stats.payload != c->payload) {
+		if(c->stats.payload)
+			stats_add_payload(s, c->stats.payload, -1);
+
+		if(c->payload)
+			stats_add_payload(s, c->payload, 1);
+
+		c->stats.payload = c->payload;
+	}
+
+	size_t memory = layer_chunk_own_memory(c);
+	size_t gpu_bytes = 0;
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS; k++)
+		gpu_bytes += c->render[k].vertices * sizeof(struct render_vertex);
+
+	s->memory = s->memory - c->stats.memory + memory;
+	s->gpu_bytes = s->gpu_bytes - c->stats.gpu_bytes + gpu_bytes;
+	c->stats.memory = memory;
+	c->stats.gpu_bytes = gpu_bytes;
+}
+
+void layer_chunk_mark_dirty(struct layer_chunk* c) {
+	assert(c);
+
+	c->lod.dirty = true;
+	c->page.dirty = true;
+	c->light.changed = true;
+	c->light.dirty = true;
+	changes++;
+	layer_chunk_queue_light(c);
 
-	free(c->blocks);
+	// outdated, the next bake replaces it
+	light_cancel(c);
+	free(c->light.vertices);
+	c->light.vertices = NULL;
+	c->light.pending = false;
+
+	for(size_t k = 0; k < LAYER_CHUNK_LODS; k++)
+		c->render[k].vbo_dirty = true;
+
+	layer_chunk_account(c);
+}
+
+void layer_chunk_queue_light(struct layer_chunk* c) {
+	assert(c);
+
+	struct layer_light* q = c->light.queue;
+
+	if(!q || c->light.queued)
+		return;
+
+	if(q->queued == q->queue_capacity) {
+		q->queue_capacity = q->queue_capacity ? q->queue_capacity * 2 : 64;
+		q->queue = realloc(q->queue,
+						   q->queue_capacity * sizeof(struct layer_chunk*));
+		assert(q->queue);
+	}
+
+	c->light.queue_index = q->queued;
+	c->light.queued = true;
+	q->queue[q->queued++] = c;
 }
 
 bool layer_chunk_is_solid(struct layer_chunk* c, int x, int y, int z) {
-	assert(c && x >= 0 && y >= 0 && z >= 0 && x < LAYER_CHUNK_SIZE
-		   && y < LAYER_CHUNK_SIZE && z < LAYER_CHUNK_SIZE);
+	assert(c && c->payload && x >= 0 && y >= 0 && z >= 0
+		   && x < LAYER_CHUNK_SIZE && y < LAYER_CHUNK_SIZE
+		   && z < LAYER_CHUNK_SIZE);
 
 	if(!c->solid_blocks)
 		return false;
 
-	return c->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid;
+	return c->payload->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid;
 }
 
 struct color layer_chunk_get_color(struct layer_chunk* c, int x, int y, int z) {
-	assert(c && x >= 0 && y >= 0 && z >= 0 && x < LAYER_CHUNK_SIZE
-		   && y < LAYER_CHUNK_SIZE && z < LAYER_CHUNK_SIZE);
+	assert(c && c->payload && x >= 0 && y >= 0 && z >= 0
+		   && x < LAYER_CHUNK_SIZE && y < LAYER_CHUNK_SIZE
+		   && z < LAYER_CHUNK_SIZE);
 
-	return c->blocks[LAYER_CHUNK_INDEX(x, y, z)].color;
+	return c->payload->blocks[LAYER_CHUNK_INDEX(x, y, z)].color;
+}
+
+struct layer_chunk_block* layer_chunk_edit_begin(struct layer_chunk* c) {
+	assert(c && c->payload);
+
+	c->payload = payload_unique(c->payload);
+
+	return c->payload->blocks;
+}
+
+void layer_chunk_edit_end(struct layer_chunk* c) {
+	assert(c && c->payload && !c->payload->shared);
+	layer_chunk_mark_dirty(c);
+}
+
+void layer_chunk_replace(struct layer_chunk* c,
+						 struct layer_chunk_payload* payload,
+						 size_t solid_blocks) {
+	assert(c && c->payload && payload && solid_blocks <= LAYER_CHUNK_VOLUME);
+
+	if(c->stats.layer)
+		stats_add_chunk(c->stats.layer, c, -1);
+
+	payload_unref(c->payload);
+	c->payload = payload;
+	c->solid_blocks = solid_blocks;
+
+	if(c->stats.layer)
+		stats_add_chunk(c->stats.layer, c, 1);
+
+	layer_chunk_mark_dirty(c);
 }
 
 void layer_chunk_set_air(struct layer_chunk* c, int x, int y, int z) {
-	assert(c && x >= 0 && y >= 0 && z >= 0 && x < LAYER_CHUNK_SIZE
-		   && y < LAYER_CHUNK_SIZE && z < LAYER_CHUNK_SIZE);
+	assert(c && c->payload && x >= 0 && y >= 0 && z >= 0
+		   && x < LAYER_CHUNK_SIZE && y < LAYER_CHUNK_SIZE
+		   && z < LAYER_CHUNK_SIZE);
 
 	if(layer_chunk_is_solid(c, x, y, z)) {
+		if(c->stats.layer)
+			stats_add_voxel(c->stats.layer, c->x * LAYER_CHUNK_SIZE + x,
+							c->y * LAYER_CHUNK_SIZE + y,
+							c->z * LAYER_CHUNK_SIZE + z,
+							layer_chunk_get_color(c, x, y, z), -1);
+
+		c->payload = payload_unique(c->payload);
 		c->solid_blocks--;
-		c->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid = false;
+		c->payload->blocks[LAYER_CHUNK_INDEX(x, y, z)]
+			= (struct layer_chunk_block) {.solid = false};
+		layer_chunk_mark_dirty(c);
 	}
 }
 
 void layer_chunk_set_solid(struct layer_chunk* c, int x, int y, int z,
 						   struct color color) {
-	assert(c && x >= 0 && y >= 0 && z >= 0 && x < LAYER_CHUNK_SIZE
-		   && y < LAYER_CHUNK_SIZE && z < LAYER_CHUNK_SIZE);
+	assert(c && c->payload && x >= 0 && y >= 0 && z >= 0
+		   && x < LAYER_CHUNK_SIZE && y < LAYER_CHUNK_SIZE
+		   && z < LAYER_CHUNK_SIZE);
+
+	struct layer_chunk_block* b
+		= c->payload->blocks + LAYER_CHUNK_INDEX(x, y, z);
+
+	if(b->solid && b->color.red == color.red && b->color.green == color.green
+	   && b->color.blue == color.blue)
+		return;
+
+	if(c->stats.layer) {
+		if(b->solid) {
+			stats_add_color(c->stats.layer, b->color, -1);
+			stats_add_color(c->stats.layer, color, 1);
+		} else {
+			stats_add_voxel(c->stats.layer, c->x * LAYER_CHUNK_SIZE + x,
+							c->y * LAYER_CHUNK_SIZE + y,
+							c->z * LAYER_CHUNK_SIZE + z, color, 1);
+		}
+	}
 
-	if(!layer_chunk_is_solid(c, x, y, z)) {
-		c->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid = true;
+	c->payload = payload_unique(c->payload);
+	b = c->payload->blocks + LAYER_CHUNK_INDEX(x, y, z);
+
+	if(!b->solid) {
+		b->solid = true;
 		c->solid_blocks++;
 	}
 
-	c->blocks[LAYER_CHUNK_INDEX(x, y, z)].color = color;
+	b->color = color;
+	layer_chunk_mark_dirty(c);
 }
 
-void layer_chunk_write(struct layer_chunk* c, struct output_stream* out) {
-	assert(c && out);
+void layer_chunk_write(struct layer_chunk* c, struct output_stream* out,
+					   struct payload_index* index) {
+	assert(c && out && index);
 
 	if(c->solid_blocks) {
+		layer_chunk_share(c);
+
 		outs_write32s(out, c->x);
 		outs_write32s(out, c->y);
 		outs_write32s(out, c->z);
-
-		for(size_t k = 0;
-			k < LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE; k++) {
-			outs_write8u(out, c->blocks[k].solid);
-			outs_write8u(out, c->blocks[k].color.red);
-			outs_write8u(out, c->blocks[k].color.green);
-			outs_write8u(out, c->blocks[k].color.blue);
-		}
+		outs_write32u(out, payload_index_add(index, c->payload));
 	}
 }
 
-bool layer_chunk_read(struct layer_chunk* c, struct input_stream* in) {
-	assert(c && in);
+bool layer_chunk_read(struct layer_chunk* c, struct input_stream* in,
+					  struct layer_chunk_payload** payloads, size_t length) {
+	assert(c && in && payloads);
 
-	if(ins_available(in) < 3 * sizeof(int32_t)
-		   + LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * 4
-			   * sizeof(uint8_t))
+	if(ins_available(in) < 4 * sizeof(int32_t))
 		return false;
 
-	c->blocks = malloc(LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE
-					   * sizeof(struct layer_chunk_block));
+	int x = ins_read32s(in);
+	int y = ins_read32s(in);
+	int z = ins_read32s(in);
+	uint32_t id = ins_read32u(in);
 
-	c->x = ins_read32s(in);
-	c->y = ins_read32s(in);
-	c->z = ins_read32s(in);
+	if(id >= length)
+		return false;
 
-	c->solid_blocks = 0;
+	layer_chunk_init(c, x, y, z);
+	payload_unref(c->payload);
+	c->payload = payload_ref(payloads[id]);
 
-	for(size_t k = 0;
-		k < LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE; k++) {
-		c->blocks[k] = (struct layer_chunk_block) {
-            .solid = ins_read8u(in),
-				.color = (struct color) {
-					.red = ins_read8u(in),
-					.green = ins_read8u(in),
-					.blue = ins_read8u(in),
-				},
-			};
-
-		if(c->blocks[k].solid)
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		if(c->payload->blocks[k].solid)
 			c->solid_blocks++;
 	}
 
 	return true;
 }
 
-void layer_chunk_render(struct layer_chunk* c) {
-	assert(c);
+// reduces cells of (1 << level)^3 voxels of level 0 to one block
+static void layer_chunk_lod_reduce(struct layer_chunk* c, size_t level,
+								   struct layer_chunk_block* out) {
+	size_t size = LAYER_CHUNK_LOD_SIZE(level);
+	size_t cell = 1 << level;
+
+	for(size_t z = 0; z < size; z++) {
+		for(size_t y = 0; y < size; y++) {
+			for(size_t x = 0; x < size; x++) {
+				size_t solid = 0;
+				uint32_t r = 0, g = 0, b = 0;
+
+				for(size_t k = 0; k < cell * cell * cell; k++) {
+					struct layer_chunk_block* src = c->payload->blocks
+						+ LAYER_CHUNK_INDEX(x * cell + k % cell,
+											y * cell + k / cell % cell,
+											z * cell + k / (cell * cell));
+
+					if(src->solid) {
+						r += src->color.red;
+						g += src->color.green;
+						b += src->color.blue;
+						solid++;
+					}
+				}
 
-	if(!c->render.has_vbo) {
-		glGenBuffers(1, &c->render.vbo);
-		c->render.has_vbo = true;
+				bool is_solid = (c->lod.mode == LOD_ANY_SOLID) ?
+					solid > 0 :
+					solid * 2 >= cell * cell * cell;
+
+				out[LAYER_CHUNK_LOD_INDEX(x, y, z, level)] = is_solid ?
+					(struct layer_chunk_block) {
+						.solid = true,
+						.color = (struct color) {r / solid, g / solid,
+												 b / solid},
+					} :
+					(struct layer_chunk_block) {.solid = false};
+			}
+		}
 	}
+}
 
-	glBindBuffer(GL_ARRAY_BUFFER, c->render.vbo);
+static void layer_chunk_lod_update(struct layer_chunk* c) {
+	if(!c->lod.dirty && c->lod.mode == lod_mode)
+		return;
 
-	if(c->render.vbo_dirty) {
-		c->render.vbo_dirty = false;
+	if(!c->lod.blocks[0]) {
+		size_t total = 0;
 
-		struct output_stream vertices;
-		outs_create(&vertices);
+		for(size_t k = 1; k < LAYER_CHUNK_LODS; k++)
+			total += LAYER_CHUNK_LOD_SIZE(k) * LAYER_CHUNK_LOD_SIZE(k)
+				* LAYER_CHUNK_LOD_SIZE(k);
 
-		c->render.vertices = 0;
+		c->lod.blocks[0] = malloc(total * sizeof(struct layer_chunk_block));
+		assert(c->lod.blocks[0]);
 
-		for(size_t x = 0; x < LAYER_CHUNK_SIZE; x++) {
-			for(size_t y = 0; y < LAYER_CHUNK_SIZE; y++) {
-				for(size_t z = 0; z < LAYER_CHUNK_SIZE; z++) {
-					if(c->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid) {
-						outs_write8u(&vertices, x);
-						outs_write8u(&vertices, y);
-						outs_write8u(&vertices, z);
-						c->render.vertices++;
+		for(size_t k = 1; k < LAYER_CHUNK_LODS - 1; k++)
+			c->lod.blocks[k] = c->lod.blocks[k - 1]
+				+ LAYER_CHUNK_LOD_SIZE(k) * LAYER_CHUNK_LOD_SIZE(k)
+					* LAYER_CHUNK_LOD_SIZE(k);
+	}
+
+	// a change of mode must rebuild the meshes of all levels
+	if(c->lod.mode != lod_mode) {
+		for(size_t k = 1; k < LAYER_CHUNK_LODS; k++)
+			c->render[k].vbo_dirty = true;
+	}
+
+	c->lod.mode = lod_mode;
+	c->lod.dirty = false;
+
+	for(size_t k = 1; k < LAYER_CHUNK_LODS; k++)
+		layer_chunk_lod_reduce(c, k, c->lod.blocks[k - 1]);
+}
+
+static struct render_vertex* mesh_buffer = NULL;
+
+// emits one quad per face that is not covered by a solid neighbor cell
+static size_t layer_chunk_mesh(struct layer_chunk_block* blocks, size_t level,
+							   struct render_vertex* out) {
+	int size = LAYER_CHUNK_LOD_SIZE(level);
+	int cell = 1 << level;
+	size_t quads = 0;
+
+	for(int z = 0; z < size; z++) {
+		for(int y = 0; y < size; y++) {
+			for(int x = 0; x < size; x++) {
+				struct layer_chunk_block* b
+					= blocks + LAYER_CHUNK_LOD_INDEX(x, y, z, level);
+
+				if(!b->solid)
+					continue;
+
+				uint16_t color = render_pack_color(b->color);
+
+				for(int face = 0; face < 6; face++) {
+					int nx = x + render_face_normals[face][0];
+					int ny = y + render_face_normals[face][1];
+					int nz = z + render_face_normals[face][2];
+
+					if(nx >= 0 && ny >= 0 && nz >= 0 && nx < size
+					   && ny < size && nz < size
+					   && blocks[LAYER_CHUNK_LOD_INDEX(nx, ny, nz, level)]
+							  .solid)
+						continue;
+
+					int axis = face / 2;
+					int u = (axis + 1) % 3;
+					int v = (axis + 2) % 3;
+					int base[3] = {x * cell, y * cell, z * cell};
+
+					if(face & 1)
+						base[axis] += cell;
+
+					for(int k = 0; k < 4; k++) {
+						int pos[3] = {base[0], base[1], base[2]};
+						pos[u] += render_face_corners[face & 1][k][0] * cell;
+						pos[v] += render_face_corners[face & 1][k][1] * cell;
+
+						out[quads * 4 + k] = (struct render_vertex) {
+							.x = pos[0],
+							.y = pos[1],
+							.z = pos[2],
+							.face = face,
+							.color = color,
+							.light = 255,
+						};
 					}
+
+					quads++;
 				}
 			}
 		}
+	}
+
+	assert(quads <= RENDER_MAX_QUADS);
 
-		glBufferData(GL_ARRAY_BUFFER, vertices.length, vertices.data,
-					 GL_STATIC_DRAW);
+	return quads;
+}
+
+void layer_chunk_render(struct layer_chunk* c, size_t level) {
+	assert(c && c->payload && level < LAYER_CHUNK_LODS);
+
+	if(!c->render[level].has_vbo) {
+		glGenBuffers(1, &c->render[level].vbo);
+		c->render[level].has_vbo = true;
 	}
 
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_BYTE, GL_FALSE, 0, NULL);
-	glDrawArrays(GL_POINTS, 0, c->render.vertices);
-	glDisableVertexAttribArray(0);
+	if(level > 0)
+		layer_chunk_lod_update(c);
+
+	if(level == 0 && c->light.pending) {
+		c->render[0].vbo_dirty = false;
+		c->render[0].vertices = c->light.quads * 4;
+
+		render_upload(c->render[0].vbo, c->light.vertices,
+					  c->light.quads * 4);
+
+		free(c->light.vertices);
+		c->light.vertices = NULL;
+		c->light.pending = false;
+		layer_chunk_account(c);
+	} else if(c->render[level].vbo_dirty) {
+		// unlit fallback, also used by all coarser levels, shows edited
+		// blocks until their bake is done, changes of neighbors keep the
+		// baked mesh as they don't touch vbo_dirty
+		c->render[level].vbo_dirty = false;
+
+		struct layer_chunk_block* blocks
+			= (level > 0) ? c->lod.blocks[level - 1] : c->payload->blocks;
+
+		if(!mesh_buffer) {
+			mesh_buffer
+				= malloc(RENDER_MAX_QUADS * 4 * sizeof(struct render_vertex));
+			assert(mesh_buffer);
+		}
+
+		size_t quads = layer_chunk_mesh(blocks, level, mesh_buffer);
+		c->render[level].vertices = quads * 4;
+
+		render_upload(c->render[level].vbo, mesh_buffer, quads * 4);
+		// also counts detail levels allocated above
+		layer_chunk_account(c);
+	}
 
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	render_draw_quads(c->render[level].vbo, c->render[level].vertices / 4,
+					  c->x * LAYER_CHUNK_SIZE, c->y * LAYER_CHUNK_SIZE,
+					  c->z * LAYER_CHUNK_SIZE);
 }
@@ -28,40 +28,125 @@
 #include "color.h"
 #include "input_stream.h"
 #include "output_stream.h"
+#include "payload.h"
+#include "render.h"
+#include "stats.h"
 
-// must be power of 2
-#define LAYER_CHUNK_SIZE 16
+// level 0 is full resolution, each further level halves it
+#define LAYER_CHUNK_LODS 3
+#define LAYER_CHUNK_LOD_SIZE(level) (LAYER_CHUNK_SIZE >> (level))
 
-struct layer_chunk_block {
-	bool solid;
-	struct color color;
+enum layer_chunk_lod_mode {
+	LOD_MAJORITY = 0,
+	LOD_ANY_SOLID = 1,
 };
 
 struct layer_chunk {
 	int x, y, z;
 	size_t solid_blocks;
-	struct layer_chunk_block* blocks;
+	struct layer_chunk_payload* payload;
+	struct {
+		bool dirty;
+		enum layer_chunk_lod_mode mode;
+		// levels 1 and up, allocated on first use
+		struct layer_chunk_block* blocks[LAYER_CHUNK_LODS - 1];
+	} lod;
 	struct {
 		bool has_vbo;
 		bool vbo_dirty;
 		GLuint vbo;
 		size_t vertices;
-	} render;
+	} render[LAYER_CHUNK_LODS];
+	// level 0 mesh with ambient occlusion and sunlight, see light.h
+	struct {
+		// blocks changed since columns were computed
+		bool changed;
+		// chunk or its neighborhood changed since the last bake
+		bool dirty;
+		// bit x of entry y is set if column x, y has any solid block
+		uint16_t columns[LAYER_CHUNK_SIZE];
+		// baked quads waiting for upload by layer_chunk_render()
+		bool pending;
+		struct render_vertex* vertices;
+		size_t quads;
+		// bake in the background, NULL if none
+		struct light_job* job;
+		// of the layer, NULL while the chunk is not part of one
+		struct layer_light* queue;
+		// index in the queue, only valid while queued
+		size_t queue_index;
+		bool queued;
+	} light;
+	// aggregates of the layer holding the chunk, see stats.h
+	struct {
+		// NULL while the chunk is not part of a layer
+		struct stats* layer;
+		// payload counted in the layer, see stats_add_payload()
+		struct layer_chunk_payload* payload;
+		// last memory added to the layer
+		size_t memory;
+		size_t gpu_bytes;
+	} stats;
+	// payload is NULL while the chunk is paged out
+	struct {
+		bool linked;
+		// stored copy is outdated
+		bool dirty;
+		// in chunk store, -1 if never stored
+		long offset;
+		size_t last_use;
+		struct layer_chunk* prev;
+		struct layer_chunk* next;
+	} page;
 };
 
+void layer_chunk_set_lod_mode(enum layer_chunk_lod_mode mode);
+// counts calls to layer_chunk_mark_dirty() of any chunk
+size_t layer_chunk_changes(void);
+
 void layer_chunk_init(struct layer_chunk* c, int x, int y, int z);
+void layer_chunk_copy(struct layer_chunk* dst, struct layer_chunk* src);
 void layer_chunk_destroy(struct layer_chunk* c);
+void layer_chunk_share(struct layer_chunk* c);
+void layer_chunk_mark_dirty(struct layer_chunk* c);
+// lists a chunk with changed blocks or dirty light for light_update()
+void layer_chunk_queue_light(struct layer_chunk* c);
+
+// releases blocks, detail levels and GPU buffers
+void layer_chunk_evict(struct layer_chunk* c);
+void layer_chunk_restore(struct layer_chunk* c,
+						 struct layer_chunk_payload* payload);
+bool layer_chunk_resident(struct layer_chunk* c);
+// its share of the payload, detail levels and meshes
+size_t layer_chunk_memory(struct layer_chunk* c);
+// updates the memory counted in the layer stats after any change of it
+void layer_chunk_account(struct layer_chunk* c);
 
 bool layer_chunk_is_solid(struct layer_chunk* c, int x, int y, int z);
 struct color layer_chunk_get_color(struct layer_chunk* c, int x, int y, int z);
 
+/*
+	Bulk edits write directly to the returned blocks and must keep
+	solid_blocks up to date. Air blocks must have a zero color. Finishing
+	the edit marks the chunk dirty once. The voxels changed are counted in
+	the layer stats by the caller, see layer_count_chunks().
+*/
+struct layer_chunk_block* layer_chunk_edit_begin(struct layer_chunk* c);
+void layer_chunk_edit_end(struct layer_chunk* c);
+// takes over the reference, e.g. to a shared payload, and marks dirty
+void layer_chunk_replace(struct layer_chunk* c,
+						 struct layer_chunk_payload* payload,
+						 size_t solid_blocks);
+
 void layer_chunk_set_air(struct layer_chunk* c, int x, int y, int z);
 void layer_chunk_set_solid(struct layer_chunk* c, int x, int y, int z,
 						   struct color color);
 
-bool layer_chunk_read(struct layer_chunk* c, struct input_stream* in);
-void layer_chunk_write(struct layer_chunk* c, struct output_stream* out);
+bool layer_chunk_read(struct layer_chunk* c, struct input_stream* in,
+					  struct layer_chunk_payload** payloads, size_t length);
+void layer_chunk_write(struct layer_chunk* c, struct output_stream* out,
+					   struct payload_index* index);
 
-void layer_chunk_render(struct layer_chunk* c);
+void layer_chunk_render(struct layer_chunk* c, size_t level);
 
 #endif
@@ -0,0 +1,36 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+
+#include "color.h"
+
+static uint8_t color_mix(uint8_t a, uint8_t b, float s) {
+	return (uint8_t)(a + (b - a) * s + 0.5F);
+}
+
+struct color color_blend(struct color a, struct color b, float s) {
+	assert(s >= 0.0F && s <= 1.0F);
+
+	return (struct color) {
+		.red = color_mix(a.red, b.red, s),
+		.green = color_mix(a.green, b.green, s),
+		.blue = color_mix(a.blue, b.blue, s),
+	};
+}
@@ -26,6 +26,7 @@ struct color {
 	uint8_t red, green, blue;
 };
 
+// a at s = 0 to b at s = 1
 struct color color_blend(struct color a, struct color b, float s);
 
 #endif
@@ -0,0 +1,280 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edit_batch.h"
+#include "thread_pool.h"
+
+// 21 bits per chunk coordinate
+#define EDIT_KEY_BIAS (1 << 20)
+#define EDIT_KEY_MASK ((1 << 21) - 1)
+#define EDIT_KEY_FITS(x)                                                       \
+	(LAYER_CHUNK_COORD(x) >= -EDIT_KEY_BIAS                                    \
+	 && LAYER_CHUNK_COORD(x) < EDIT_KEY_BIAS)
+
+struct edit_key {
+	uint64_t key;
+	size_t index;
+};
+
+struct edit_run {
+	size_t start;
+	size_t length;
+	struct layer_chunk* chunk;
+	struct layer_chunk_block* blocks;
+};
+
+struct edit_context {
+	struct edit* edits;
+	struct edit_run* runs;
+	struct edit* undo;
+};
+
+void edit_batch_create(struct edit_batch* b) {
+	assert(b);
+
+	b->length = 0;
+	b->capacity = 256;
+	b->edits = malloc(b->capacity * sizeof(struct edit));
+	assert(b->edits);
+}
+
+void edit_batch_destroy(struct edit_batch* b) {
+	assert(b);
+	free(b->edits);
+}
+
+void edit_batch_clear(struct edit_batch* b) {
+	assert(b);
+	b->length = 0;
+}
+
+static void edit_batch_reserve(struct edit_batch* b, size_t length) {
+	if(length > b->capacity) {
+		while(length > b->capacity)
+			b->capacity *= 2;
+
+		b->edits = realloc(b->edits, b->capacity * sizeof(struct edit));
+		assert(b->edits);
+	}
+}
+
+static void edit_batch_add(struct edit_batch* b, struct edit e) {
+	// chunks further out would share their key with other chunks
+	assert(EDIT_KEY_FITS(e.x) && EDIT_KEY_FITS(e.y) && EDIT_KEY_FITS(e.z));
+
+	edit_batch_reserve(b, b->length + 1);
+	b->edits[b->length++] = e;
+}
+
+void edit_batch_set_air(struct edit_batch* b, int x, int y, int z) {
+	assert(b);
+	edit_batch_add(b, (struct edit) {.x = x, .y = y, .z = z, .op = EDIT_AIR});
+}
+
+void edit_batch_set_solid(struct edit_batch* b, int x, int y, int z,
+						  struct color color) {
+	assert(b);
+	edit_batch_add(b,
+				   (struct edit) {
+					   .x = x,
+					   .y = y,
+					   .z = z,
+					   .op = EDIT_SOLID,
+					   .color = color,
+				   });
+}
+
+static uint64_t edit_key(struct edit* e) {
+	return ((uint64_t)((LAYER_CHUNK_COORD(e->x) + EDIT_KEY_BIAS)
+					   & EDIT_KEY_MASK)
+			<< 42)
+		| ((uint64_t)((LAYER_CHUNK_COORD(e->y) + EDIT_KEY_BIAS)
+					  & EDIT_KEY_MASK)
+		   << 21)
+		| ((LAYER_CHUNK_COORD(e->z) + EDIT_KEY_BIAS) & EDIT_KEY_MASK);
+}
+
+// stable LSD radix sort, skips bytes equal in all keys
+static void edit_sort(struct edit_key* keys, struct edit_key* tmp,
+					  size_t length) {
+	struct edit_key* src = keys;
+	struct edit_key* dst = tmp;
+
+	for(size_t shift = 0; shift < 64; shift += 8) {
+		size_t count[256] = {0};
+
+		for(size_t k = 0; k < length; k++)
+			count[(src[k].key >> shift) & 0xFF]++;
+
+		if(count[(src[0].key >> shift) & 0xFF] == length)
+			continue;
+
+		size_t offset = 0;
+
+		for(size_t k = 0; k < 256; k++) {
+			size_t n = count[k];
+			count[k] = offset;
+			offset += n;
+		}
+
+		for(size_t k = 0; k < length; k++)
+			dst[count[(src[k].key >> shift) & 0xFF]++] = src[k];
+
+		struct edit_key* swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	if(src != keys)
+		memcpy(keys, src, length * sizeof(struct edit_key));
+}
+
+static void edit_batch_apply_run(size_t job, void* user) {
+	struct edit_context* ctx = (struct edit_context*)user;
+	struct edit_run* run = ctx->runs + job;
+
+	for(size_t k = 0; k < run->length; k++) {
+		struct edit* e = ctx->edits + run->start + k;
+		struct layer_chunk_block air = {.solid = false};
+		struct layer_chunk_block* b = run->blocks ?
+			run->blocks
+				+ LAYER_CHUNK_INDEX(LAYER_LOCAL_COORD(e->x),
+									LAYER_LOCAL_COORD(e->y),
+									LAYER_LOCAL_COORD(e->z)) :
+			&air;
+
+		// reversed, so the oldest state of a voxel is restored last
+		if(ctx->undo)
+			ctx->undo[run->start + run->length - 1 - k] = (struct edit) {
+				.x = e->x,
+				.y = e->y,
+				.z = e->z,
+				.op = b->solid ? EDIT_SOLID : EDIT_AIR,
+				.color = b->color,
+			};
+
+		if(!run->blocks)
+			continue;
+
+		if(e->op == EDIT_SOLID) {
+			if(!b->solid)
+				run->chunk->solid_blocks++;
+
+			*b = (struct layer_chunk_block) {.solid = true, .color = e->color};
+		} else if(b->solid) {
+			run->chunk->solid_blocks--;
+			*b = (struct layer_chunk_block) {.solid = false};
+		}
+	}
+}
+
+void edit_batch_apply(struct edit_batch* b, struct layer* l,
+					  struct edit_batch* undo) {
+	assert(b && l && b != undo);
+
+	if(undo) {
+		edit_batch_clear(undo);
+		edit_batch_reserve(undo, b->length);
+		undo->length = b->length;
+	}
+
+	if(!b->length)
+		return;
+
+	struct edit_key* keys = malloc(b->length * 2 * sizeof(struct edit_key));
+	struct edit* edits = malloc(b->length * sizeof(struct edit));
+	assert(keys && edits);
+
+	for(size_t k = 0; k < b->length; k++)
+		keys[k] = (struct edit_key) {.key = edit_key(b->edits + k), .index = k};
+
+	edit_sort(keys, keys + b->length, b->length);
+
+	size_t run_count = 0;
+
+	for(size_t k = 0; k < b->length; k++) {
+		edits[k] = b->edits[keys[k].index];
+
+		if(k == 0 || keys[k].key != keys[k - 1].key)
+			run_count++;
+	}
+
+	struct edit_run* runs = malloc(run_count * sizeof(struct edit_run));
+	assert(runs);
+
+	// all changes to the chunk table happen here, serialized
+	size_t run = 0;
+
+	for(size_t k = 0; k < b->length; run++) {
+		struct edit* first = edits + k;
+		bool create = false;
+
+		runs[run].start = k;
+
+		for(; k < b->length && keys[k].key == keys[runs[run].start].key; k++)
+			create = create || edits[k].op == EDIT_SOLID;
+
+		runs[run].length = k - runs[run].start;
+		runs[run].chunk = layer_get_chunk(l, LAYER_CHUNK_COORD(first->x),
+										  LAYER_CHUNK_COORD(first->y),
+										  LAYER_CHUNK_COORD(first->z), create);
+		runs[run].blocks = runs[run].chunk ?
+			layer_chunk_edit_begin(runs[run].chunk) :
+			NULL;
+	}
+
+	free(keys);
+
+	struct edit_context ctx = {
+		.edits = edits,
+		.runs = runs,
+		.undo = undo ? undo->edits : NULL,
+	};
+
+	struct layer_chunk** chunks = malloc(run_count * sizeof(*chunks));
+	size_t chunk_count = 0;
+	assert(chunks);
+
+	for(size_t k = 0; k < run_count; k++) {
+		if(runs[k].chunk)
+			chunks[chunk_count++] = runs[k].chunk;
+	}
+
+	// bulk edits count their chunks before and after changing them
+	layer_count_chunks(l, chunks, chunk_count, -1);
+	thread_pool_run(run_count, edit_batch_apply_run, &ctx);
+	layer_count_chunks(l, chunks, chunk_count, 1);
+	free(chunks);
+
+	for(size_t k = 0; k < run_count; k++) {
+		if(runs[k].chunk) {
+			layer_chunk_edit_end(runs[k].chunk);
+
+			if(!runs[k].chunk->solid_blocks)
+				layer_remove_chunk(l, runs[k].chunk);
+		}
+	}
+
+	free(runs);
+	free(edits);
+}
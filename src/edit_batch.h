@@ -0,0 +1,64 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_EDIT_BATCH_H
+#define PINKED_EDIT_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "layer.h"
+
+enum edit_op {
+	EDIT_AIR = 0,
+	EDIT_SOLID = 1,
+};
+
+struct edit {
+	int x, y, z;
+	uint8_t op;
+	struct color color;
+};
+
+struct edit_batch {
+	struct edit* edits;
+	size_t length;
+	size_t capacity;
+};
+
+void edit_batch_create(struct edit_batch* b);
+void edit_batch_destroy(struct edit_batch* b);
+void edit_batch_clear(struct edit_batch* b);
+
+// chunk coordinates of edits have to be within -2^20 and 2^20 - 1
+void edit_batch_set_air(struct edit_batch* b, int x, int y, int z);
+void edit_batch_set_solid(struct edit_batch* b, int x, int y, int z,
+						  struct color color);
+
+/*
+	Edits are grouped by chunk and each chunk is edited on a worker thread.
+	Later edits of the same voxel win, just like applying them one by one.
+	If undo is not NULL it is replaced by a batch restoring the previous
+	state of the layer.
+*/
+void edit_batch_apply(struct edit_batch* b, struct layer* l,
+					  struct edit_batch* undo);
+
+#endif
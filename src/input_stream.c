@@ -38,17 +38,16 @@ size_t ins_available(struct input_stream* in) {
 int32_t ins_read32s(struct input_stream* in) {
 	assert(in && ins_available(in) >= sizeof(int32_t));
 
-	int32_t v = ((int32_t*)in->data)[in->offset];
-	in->offset += sizeof(int32_t);
-	return v;
+	return (int32_t)ins_read32u(in);
 }
 
 uint32_t ins_read32u(struct input_stream* in) {
 	assert(in && ins_available(in) >= sizeof(uint32_t));
 
-	uint32_t v = ((uint32_t*)in->data)[in->offset];
+	uint8_t* data = (uint8_t*)in->data + in->offset;
 	in->offset += sizeof(uint32_t);
-	return v;
+	return data[0] | (data[1] << 8) | (data[2] << 16)
+		| ((uint32_t)data[3] << 24);
 }
 
 uint8_t ins_read8u(struct input_stream* in) {
@@ -71,12 +70,12 @@ bool ins_read_string(struct input_stream* in, char* str, size_t length) {
 	if(ins_available(in) < available)
 		return false;
 
-	size_t min_length = (length < available) ? length : available;
+	size_t min_length = (length - 1 < available) ? length - 1 : available;
 
 	strncpy(str, (char*)in->data + in->offset, min_length);
-	str[min_length - 1] = 0;
+	str[min_length] = 0;
 
-	ins_skip(in, available - min_length);
+	ins_skip(in, available);
 
 	return true;
 }
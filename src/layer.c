@@ -18,20 +18,24 @@
 */
 
 #include <assert.h>
+#include <math.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "layer.h"
+#include "light.h"
+#include "pager.h"
+#include "thread_pool.h"
 
 #define HT_CHUNK_KEY(x, y, z)                                                  \
 	(int[3]) {                                                                 \
-		(x >= 0) ? (x / LAYER_CHUNK_SIZE) : ((x + 1) / LAYER_CHUNK_SIZE - 1),  \
-			(y >= 0) ? (y / LAYER_CHUNK_SIZE) :                                \
-					   ((y + 1) / LAYER_CHUNK_SIZE - 1),                       \
-			(z >= 0) ? (z / LAYER_CHUNK_SIZE) :                                \
-					   ((z + 1) / LAYER_CHUNK_SIZE - 1)                        \
+		LAYER_CHUNK_COORD(x), LAYER_CHUNK_COORD(y), LAYER_CHUNK_COORD(z)       \
 	}
 #define LOOKUP_CHUNK(l, x, y, z) ht_lookup(&l->chunks, HT_CHUNK_KEY(x, y, z))
-#define LOCAL_CHUNK_COORD(x) (x & (LAYER_CHUNK_SIZE - 1))
+#define LOCAL_CHUNK_COORD(x) LAYER_LOCAL_COORD(x)
+// header with an empty name and the chunk count
+#define LAYER_MIN_SERIALIZED_SIZE                                              \
+	(6 * sizeof(int32_t) + 2 * sizeof(uint8_t) + sizeof(uint32_t))
 
 static int chunk_coords_compare(void* a, void* b, size_t key_size) {
 	assert(a && b && key_size == sizeof(int[3]));
@@ -55,6 +59,133 @@ static size_t chunk_coords_hash(void* a, size_t key_size) {
 	return int_hash(A[0]) ^ int_hash(A[1]) ^ int_hash(A[2]);
 }
 
+void layer_chunk_table(HashTable* table, size_t value_size) {
+	assert(table && value_size > 0);
+
+	ht_setup(table, sizeof(int[3]), value_size, 256);
+	table->compare = chunk_coords_compare;
+	table->hash = chunk_coords_hash;
+}
+
+static void layer_setup_chunks(struct layer* l) {
+	layer_chunk_table(&l->chunks, sizeof(struct layer_chunk));
+
+	l->stats = malloc(sizeof(struct stats));
+	assert(l->stats);
+	stats_create(l->stats);
+
+	l->light = malloc(sizeof(struct layer_light));
+	assert(l->light);
+	l->light->removed = NULL;
+	l->light->length = 0;
+	l->light->capacity = 0;
+	l->light->queue = NULL;
+	l->light->queued = 0;
+	l->light->queue_capacity = 0;
+}
+
+static struct layer_chunk* layer_lookup_chunk(struct layer* l, int x, int y,
+											 int z) {
+	struct layer_chunk* c = LOOKUP_CHUNK(l, x, y, z);
+
+	if(c)
+		pager_touch(c);
+
+	return c;
+}
+
+static struct layer_chunk* layer_insert_chunk(struct layer* l,
+											  struct layer_chunk* c) {
+	int key[3] = {c->x, c->y, c->z};
+	ht_insert(&l->chunks, key, c);
+
+	// the table holds a copy, track it at its final address
+	struct layer_chunk* stored = ht_lookup(&l->chunks, key);
+	pager_track(stored);
+
+	// its blocks are counted by the caller, see layer_count_voxels()
+	stored->stats.layer = l->stats;
+	l->stats->chunks++;
+	layer_chunk_account(stored);
+
+	stored->light.queue = l->light;
+	layer_chunk_queue_light(stored);
+
+	return stored;
+}
+
+struct layer_count_context {
+	struct layer_chunk** chunks;
+	size_t length;
+	size_t slices;
+	struct stats* partial;
+};
+
+static bool layer_gather_chunks_callback(void* key, void* value, void* user) {
+	struct layer_count_context* ctx = (struct layer_count_context*)user;
+	struct layer_chunk* c = (struct layer_chunk*)value;
+
+	pager_touch(c);
+	ctx->chunks[ctx->length++] = c;
+
+	return true;
+}
+
+static void layer_count_slice(size_t job, void* user) {
+	struct layer_count_context* ctx = (struct layer_count_context*)user;
+	struct stats* s = ctx->partial + job;
+
+	stats_create(s);
+
+	for(size_t k = ctx->length * job / ctx->slices;
+		k < ctx->length * (job + 1) / ctx->slices; k++)
+		stats_add_chunk(s, ctx->chunks[k], 1);
+}
+
+void layer_count_chunks(struct layer* l, struct layer_chunk** chunks,
+						size_t length, int sign) {
+	assert(l && (chunks || !length) && (sign == 1 || sign == -1));
+
+	if(!length)
+		return;
+
+	// each worker counts into its own stats
+	struct layer_count_context ctx = {
+		.chunks = chunks,
+		.length = length,
+		.slices = thread_pool_threads(),
+	};
+
+	ctx.partial = malloc(ctx.slices * sizeof(struct stats));
+	assert(ctx.partial);
+
+	thread_pool_run(ctx.slices, layer_count_slice, &ctx);
+
+	for(size_t k = 0; k < ctx.slices; k++) {
+		stats_merge_voxels(l->stats, ctx.partial + k, sign);
+		stats_destroy(ctx.partial + k);
+	}
+
+	free(ctx.partial);
+}
+
+// counts the voxels of all chunks again
+static void layer_count_voxels(struct layer* l) {
+	struct layer_count_context ctx = {
+		.chunks = malloc(l->chunks.size * sizeof(struct layer_chunk*)),
+		.length = 0,
+	};
+
+	assert(ctx.chunks || !l->chunks.size);
+
+	ht_iterate(&l->chunks, &ctx, layer_gather_chunks_callback);
+
+	stats_clear_voxels(l->stats);
+	layer_count_chunks(l, ctx.chunks, ctx.length, 1);
+
+	free(ctx.chunks);
+}
+
 void layer_create(struct layer* l, int x, int y, int z) {
 	assert(l);
 
@@ -67,9 +198,29 @@ void layer_create(struct layer* l, int x, int y, int z) {
 
 	strcpy(l->name, "New layer");
 
-	ht_setup(&l->chunks, sizeof(int[3]), sizeof(struct layer_chunk), 256);
-	l->chunks.compare = chunk_coords_compare;
-	l->chunks.hash = chunk_coords_hash;
+	layer_setup_chunks(l);
+}
+
+static bool layer_copy_chunks_callback(void* key, void* value, void* user) {
+	struct layer_chunk c;
+	pager_touch((struct layer_chunk*)value);
+	layer_chunk_copy(&c, (struct layer_chunk*)value);
+	layer_insert_chunk((struct layer*)user, &c);
+	return true;
+}
+
+void layer_copy(struct layer* dst, struct layer* src) {
+	assert(dst && src);
+
+	layer_create(dst, src->x, src->y, src->z);
+	dst->sx = src->sx;
+	dst->sy = src->sy;
+	dst->sz = src->sz;
+	dst->blend = src->blend;
+	strcpy(dst->name, src->name);
+
+	ht_iterate(&src->chunks, dst, layer_copy_chunks_callback);
+	stats_merge_voxels(dst->stats, src->stats, 1);
 }
 
 static bool layer_destroy_chunks_callback(void* key, void* value, void* user) {
@@ -82,12 +233,68 @@ void layer_destroy(struct layer* l) {
 
 	ht_iterate(&l->chunks, NULL, layer_destroy_chunks_callback);
 	ht_destroy(&l->chunks);
+	free(l->light->removed);
+	free(l->light->queue);
+	free(l->light);
+
+	stats_destroy(l->stats);
+	free(l->stats);
+}
+
+struct layer_chunk* layer_get_chunk(struct layer* l, int x, int y, int z,
+									bool create) {
+	assert(l);
+
+	struct layer_chunk* c = ht_lookup(&l->chunks, (int[3]) {x, y, z});
+
+	if(c) {
+		pager_touch(c);
+	} else if(create) {
+		struct layer_chunk c2;
+		layer_chunk_init(&c2, x, y, z);
+		c = layer_insert_chunk(l, &c2);
+	}
+
+	return c;
+}
+
+void layer_remove_chunk(struct layer* l, struct layer_chunk* c) {
+	assert(l && c);
+
+	struct layer_light* q = l->light;
+
+	if(q->length == q->capacity) {
+		q->capacity = q->capacity ? q->capacity * 2 : 16;
+		q->removed = realloc(q->removed,
+							 q->capacity * sizeof(struct layer_removed_chunk));
+		assert(q->removed);
+	}
+
+	struct layer_removed_chunk* r = q->removed + q->length++;
+	r->x = c->x;
+	r->y = c->y;
+	r->z = c->z;
+	memcpy(r->columns, c->light.columns, sizeof(r->columns));
+
+	if(c->solid_blocks) {
+		pager_touch(c);
+		stats_add_chunk(l->stats, c, -1);
+	}
+
+	int key[3] = {c->x, c->y, c->z};
+	layer_chunk_destroy(c);
+
+	l->stats->chunks--;
+	l->stats->memory -= c->stats.memory;
+	l->stats->gpu_bytes -= c->stats.gpu_bytes;
+
+	ht_erase(&l->chunks, key);
 }
 
 bool layer_is_solid(struct layer* l, int x, int y, int z) {
 	assert(l);
 
-	struct layer_chunk* c = LOOKUP_CHUNK(l, x, y, z);
+	struct layer_chunk* c = layer_lookup_chunk(l, x, y, z);
 
 	if(!c)
 		return false;
@@ -99,7 +306,7 @@ bool layer_is_solid(struct layer* l, int x, int y, int z) {
 struct color layer_get_color(struct layer* l, int x, int y, int z) {
 	assert(l);
 
-	struct layer_chunk* c = LOOKUP_CHUNK(l, x, y, z);
+	struct layer_chunk* c = layer_lookup_chunk(l, x, y, z);
 
 	assert(c);
 
@@ -110,41 +317,76 @@ struct color layer_get_color(struct layer* l, int x, int y, int z) {
 void layer_set_air(struct layer* l, int x, int y, int z) {
 	assert(l);
 
-	struct layer_chunk* c = LOOKUP_CHUNK(l, x, y, z);
+	struct layer_chunk* c = layer_lookup_chunk(l, x, y, z);
 
 	if(c) {
 		layer_chunk_set_air(c, LOCAL_CHUNK_COORD(x), LOCAL_CHUNK_COORD(y),
 							LOCAL_CHUNK_COORD(z));
 
-		if(!c->solid_blocks) {
-			layer_chunk_destroy(c);
-			ht_erase(&l->chunks, HT_CHUNK_KEY(x, y, z));
-		}
+		if(!c->solid_blocks)
+			layer_remove_chunk(l, c);
 	}
 }
 
 void layer_set_solid(struct layer* l, int x, int y, int z, struct color color) {
 	assert(l);
 
-	struct layer_chunk* c = LOOKUP_CHUNK(l, x, y, z);
+	struct layer_chunk* c = layer_lookup_chunk(l, x, y, z);
 
-	if(c) {
-		layer_chunk_set_solid(c, LOCAL_CHUNK_COORD(x), LOCAL_CHUNK_COORD(y),
-							  LOCAL_CHUNK_COORD(z), color);
-	} else {
+	// inserted first, so the voxel is counted in the layer stats
+	if(!c) {
 		struct layer_chunk c2;
 		int* key = HT_CHUNK_KEY(x, y, z);
 		layer_chunk_init(&c2, key[0], key[1], key[2]);
-		layer_chunk_set_solid(&c2, LOCAL_CHUNK_COORD(x), LOCAL_CHUNK_COORD(y),
-							  LOCAL_CHUNK_COORD(z), color);
-
-		ht_insert(&l->chunks, key, &c2);
+		c = layer_insert_chunk(l, &c2);
 	}
+
+	layer_chunk_set_solid(c, LOCAL_CHUNK_COORD(x), LOCAL_CHUNK_COORD(y),
+						  LOCAL_CHUNK_COORD(z), color);
 }
 
-bool layer_read(struct layer* l, struct input_stream* in) {
-	assert(l && in);
+void layer_stats(struct layer* l, struct layer_stats* stats) {
+	assert(l && stats);
+
+	*stats = (struct layer_stats) {
+		.solid_voxels = l->stats->solid,
+		.colors = l->stats->colors.size,
+		.chunks = l->stats->chunks,
+		.memory = l->stats->memory,
+		.gpu_bytes = l->stats->gpu_bytes,
+	};
+
+	stats_bounds(l->stats, stats->min, stats->max);
+}
+
+size_t layer_color_voxels(struct layer* l, struct color color) {
+	assert(l);
+	return stats_color(l->stats, color);
+}
+
+void layer_colors(struct layer* l, void* user,
+				  bool (*callback)(struct color color, size_t voxels,
+								   void* user)) {
+	assert(l && callback);
+	stats_colors(l->stats, user, callback);
+}
+
+static bool layer_share_chunks_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+
+	// evicted chunks are reshared when they are loaded again
+	if(layer_chunk_resident(c))
+		layer_chunk_share(c);
+
+	return true;
+}
 
+void layer_share_chunks(struct layer* l) {
+	assert(l);
+	ht_iterate(&l->chunks, NULL, layer_share_chunks_callback);
+}
+
+static bool layer_read_header(struct layer* l, struct input_stream* in) {
 	if(ins_available(in) < 6 * sizeof(int32_t))
 		return false;
 
@@ -161,39 +403,134 @@ bool layer_read(struct layer* l, struct input_stream* in) {
 	if(!ins_read_string(in, l->name, sizeof(l->name)))
 		return false;
 
-	if(ins_available(in) < sizeof(int32_t) + sizeof(uint8_t))
+	if(ins_available(in) < sizeof(uint8_t))
 		return false;
 
 	l->blend = (enum layer_blend_mode)ins_read8u(in);
+
+	return true;
+}
+
+static bool layer_read_chunks(struct layer* l, struct input_stream* in,
+							  struct layer_chunk_payload** payloads,
+							  size_t length) {
+	if(ins_available(in) < sizeof(uint32_t))
+		return false;
+
 	size_t read_chunks = ins_read32u(in);
 
-	ht_setup(&l->chunks, sizeof(int) * 3, sizeof(struct layer_chunk), 256);
+	// coordinates and payload id of every chunk must still follow
+	if(ins_available(in) / (4 * sizeof(uint32_t)) < read_chunks)
+		return false;
+
+	layer_setup_chunks(l);
 
 	for(size_t k = 0; k < read_chunks; k++) {
 		struct layer_chunk c;
 
-		if(!layer_chunk_read(&c, in)) {
+		if(!layer_chunk_read(&c, in, payloads, length)) {
 			layer_destroy(l);
 			return false;
 		}
 
-		ht_insert(&l->chunks, (int[3]) {c.x, c.y, c.z}, &c);
+		// a second chunk at the same place would replace and leak the first
+		if(ht_lookup(&l->chunks, (int[3]) {c.x, c.y, c.z})) {
+			layer_chunk_destroy(&c);
+			layer_destroy(l);
+			return false;
+		}
+
+		layer_insert_chunk(l, &c);
 	}
 
+	layer_count_voxels(l);
+
 	return true;
 }
 
+bool layer_read(struct layer* l, struct input_stream* in) {
+	assert(l && in);
+
+	if(!layer_read_header(l, in))
+		return false;
+
+	size_t length;
+	struct layer_chunk_payload** payloads = payload_table_read(in, &length);
+
+	if(!payloads)
+		return false;
+
+	bool success = layer_read_chunks(l, in, payloads, length);
+	payload_table_destroy(payloads, length);
+
+	return success;
+}
+
+struct layer* layers_read(struct input_stream* in, size_t* count) {
+	assert(in && count);
+
+	if(ins_available(in) < sizeof(uint32_t))
+		return NULL;
+
+	*count = ins_read32u(in);
+
+	size_t length;
+	struct layer_chunk_payload** payloads = payload_table_read(in, &length);
+
+	if(!payloads)
+		return NULL;
+
+	struct layer* layers = NULL;
+
+	if(ins_available(in) / LAYER_MIN_SERIALIZED_SIZE >= *count)
+		layers = malloc((*count + 1) * sizeof(struct layer));
+
+	if(!layers) {
+		payload_table_destroy(payloads, length);
+		return NULL;
+	}
+
+	for(size_t k = 0; k < *count; k++) {
+		if(!layer_read_header(layers + k, in)
+		   || !layer_read_chunks(layers + k, in, payloads, length)) {
+			for(size_t i = 0; i < k; i++)
+				layer_destroy(layers + i);
+
+			free(layers);
+			layers = NULL;
+			break;
+		}
+	}
+
+	payload_table_destroy(payloads, length);
+
+	return layers;
+}
+
+static bool layer_index_chunks_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+	pager_touch(c);
+	layer_chunk_share(c);
+	payload_index_add((struct payload_index*)user, c->payload);
+
+	return true;
+}
+
+struct layer_write_context {
+	struct output_stream* out;
+	struct payload_index* index;
+};
+
 static bool layer_write_chunks_callback(void* key, void* value, void* user) {
 	struct layer_chunk* c = (struct layer_chunk*)value;
+	struct layer_write_context* ctx = (struct layer_write_context*)user;
 	assert(c->solid_blocks > 0);
-	layer_chunk_write(c, (struct output_stream*)user);
+	layer_chunk_write(c, ctx->out, ctx->index);
 
 	return true;
 }
 
-void layer_write(struct layer* l, struct output_stream* out) {
-	assert(l && out);
-
+static void layer_write_header(struct layer* l, struct output_stream* out) {
 	outs_write32s(out, l->x);
 	outs_write32s(out, l->y);
 	outs_write32s(out, l->z);
@@ -204,17 +541,256 @@ void layer_write(struct layer* l, struct output_stream* out) {
 
 	outs_write_string(out, l->name);
 	outs_write8u(out, l->blend);
+}
+
+static void layer_write_chunks(struct layer* l, struct output_stream* out,
+							   struct payload_index* index) {
 	outs_write32u(out, l->chunks.size);
 
-	ht_iterate(&l->chunks, out, layer_write_chunks_callback);
+	ht_iterate(&l->chunks,
+			   &(struct layer_write_context) {.out = out, .index = index},
+			   layer_write_chunks_callback);
 }
 
-static bool layer_render_chunks_callback(void* key, void* value, void* user) {
-	layer_chunk_render((struct layer_chunk*)value);
+void layer_write(struct layer* l, struct output_stream* out) {
+	assert(l && out);
+
+	struct payload_index index;
+	payload_index_create(&index);
+	ht_iterate(&l->chunks, &index, layer_index_chunks_callback);
+
+	layer_write_header(l, out);
+	payload_index_write(&index, out);
+	layer_write_chunks(l, out, &index);
+
+	payload_index_destroy(&index);
+}
+
+void layers_write(struct layer* l, size_t count, struct output_stream* out) {
+	assert(l && out);
+
+	struct payload_index index;
+	payload_index_create(&index);
+
+	for(size_t k = 0; k < count; k++)
+		ht_iterate(&l[k].chunks, &index, layer_index_chunks_callback);
+
+	outs_write32u(out, count);
+	payload_index_write(&index, out);
+
+	for(size_t k = 0; k < count; k++) {
+		layer_write_header(l + k, out);
+		layer_write_chunks(l + k, out, &index);
+	}
+
+	payload_index_destroy(&index);
+}
+
+struct layer_render_context {
+	mat4 mvp;
+	// pixels covered by one world unit at clip w = 1
+	float pixels;
+	// change of clip w per world unit
+	float depth;
+	// change of w + x, w - x, w + y, ... per world unit, the distance to
+	// each plane of the view frustum in clip units
+	float planes[3][2];
+};
+
+struct layer_render_item {
+	struct layer_chunk* chunk;
+	// clip w of the chunk center
+	float w;
+	uint16_t key;
+};
+
+// reused every frame, rendering only ever happens on the GL thread
+static struct {
+	struct layer_render_item* items;
+	struct layer_render_item* sorted;
+	size_t length;
+	size_t capacity;
+	bool unordered;
+} render_queue;
+
+static size_t layer_chunk_select_lod(float center_w,
+									 struct layer_render_context* ctx) {
+	// w of the chunk corner closest to the camera
+	float w = center_w - ctx->depth * LAYER_CHUNK_RADIUS;
+
+	if(w <= 0.0F)
+		return 0;
+
+	float voxel_pixels = ctx->pixels / w;
+	size_t level = 0;
+
+	// only drop detail once a whole cell fits into a single pixel
+	while(level + 1 < LAYER_CHUNK_LODS
+		  && voxel_pixels * (1 << (level + 1)) <= 1.0F)
+		level++;
+
+	return level;
+}
+
+static bool layer_render_queue_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+	struct layer_render_context* ctx = (struct layer_render_context*)user;
+
+	vec4 clip;
+	glm_mat4_mulv(ctx->mvp,
+				  (vec4) {(c->x + 0.5F) * LAYER_CHUNK_SIZE,
+						  (c->y + 0.5F) * LAYER_CHUNK_SIZE,
+						  (c->z + 0.5F) * LAYER_CHUNK_SIZE, 1.0F},
+				  clip);
+
+	// entirely outside of the view, this includes chunks behind the camera
+	// which would otherwise be sorted first
+	for(int k = 0; k < 3; k++) {
+		if(clip[3] + clip[k] < -ctx->planes[k][0] * LAYER_CHUNK_RADIUS
+		   || clip[3] - clip[k] < -ctx->planes[k][1] * LAYER_CHUNK_RADIUS)
+			return true;
+	}
+
+	if(render_queue.length >= render_queue.capacity) {
+		render_queue.capacity
+			= render_queue.capacity ? render_queue.capacity * 2 : 256;
+		render_queue.items
+			= realloc(render_queue.items,
+					  render_queue.capacity * sizeof(*render_queue.items));
+		render_queue.sorted
+			= realloc(render_queue.sorted,
+					  render_queue.capacity * sizeof(*render_queue.sorted));
+		assert(render_queue.items && render_queue.sorted);
+	}
+
+	render_queue.items[render_queue.length++] = (struct layer_render_item) {
+		.chunk = c,
+		.w = clip[3],
+	};
+
 	return true;
 }
 
-void layer_render(struct layer* l) {
-	assert(l);
-	ht_iterate(&l->chunks, NULL, layer_render_chunks_callback);
+/*
+	Orders the queue front to back so that early depth testing rejects most
+	hidden fragments. Distances are quantized to 16 bits over the range of
+	the frame and sorted with two stable byte sized radix passes, linear in
+	the number of chunks.
+*/
+static void layer_render_sort(void) {
+	struct layer_render_item* items = render_queue.items;
+	struct layer_render_item* sorted = render_queue.sorted;
+	size_t length = render_queue.length;
+
+	if(length < 2)
+		return;
+
+	float min = items[0].w;
+	float max = items[0].w;
+
+	for(size_t k = 1; k < length; k++) {
+		min = fminf(min, items[k].w);
+		max = fmaxf(max, items[k].w);
+	}
+
+	float scale = max > min ? 65535.0F / (max - min) : 0.0F;
+
+	for(size_t k = 0; k < length; k++)
+		items[k].key = (uint16_t)((items[k].w - min) * scale);
+
+	for(int shift = 0; shift < 16; shift += 8) {
+		size_t offsets[256] = {0};
+
+		for(size_t k = 0; k < length; k++)
+			offsets[(items[k].key >> shift) & 0xFF]++;
+
+		size_t sum = 0;
+
+		for(size_t k = 0; k < 256; k++) {
+			size_t count = offsets[k];
+			offsets[k] = sum;
+			sum += count;
+		}
+
+		for(size_t k = 0; k < length; k++)
+			sorted[offsets[(items[k].key >> shift) & 0xFF]++] = items[k];
+
+		struct layer_render_item* tmp = items;
+		items = sorted;
+		sorted = tmp;
+	}
+
+	// an even number of passes ends up in the original buffer again
+	assert(items == render_queue.items);
+}
+
+void layer_render_ordered(bool front_to_back) {
+	render_queue.unordered = !front_to_back;
+}
+
+void layer_render(struct layer* l, mat4 mvp) {
+	assert(l && mvp);
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	struct layer_render_context ctx;
+	glm_mat4_copy(mvp, ctx.mvp);
+
+	float scale_x = sqrtf(mvp[0][0] * mvp[0][0] + mvp[1][0] * mvp[1][0]
+						  + mvp[2][0] * mvp[2][0]);
+	float scale_y = sqrtf(mvp[0][1] * mvp[0][1] + mvp[1][1] * mvp[1][1]
+						  + mvp[2][1] * mvp[2][1]);
+	ctx.pixels = fmaxf(scale_x * viewport[2], scale_y * viewport[3]) / 2.0F;
+	ctx.depth = sqrtf(mvp[0][3] * mvp[0][3] + mvp[1][3] * mvp[1][3]
+					  + mvp[2][3] * mvp[2][3]);
+
+	for(int k = 0; k < 3; k++) {
+		for(int side = 0; side < 2; side++) {
+			float sign = side ? -1.0F : 1.0F;
+			vec3 normal = {mvp[0][3] + sign * mvp[0][k],
+						   mvp[1][3] + sign * mvp[1][k],
+						   mvp[2][3] + sign * mvp[2][k]};
+			ctx.planes[k][side] = glm_vec3_norm(normal);
+		}
+	}
+
+	light_update(l);
+
+	// only visible chunks are touched, the pager may evict all others
+	render_queue.length = 0;
+	ht_iterate(&l->chunks, &ctx, layer_render_queue_callback);
+
+	if(!render_queue.unordered)
+		layer_render_sort();
+
+	for(size_t k = 0; k < render_queue.length; k++) {
+		struct layer_render_item* item = render_queue.items + k;
+		pager_touch(item->chunk);
+		layer_chunk_render(item->chunk,
+						   layer_chunk_select_lod(item->w, &ctx));
+	}
+}
+
+void layer_prefetch(struct layer* l, vec3 position, float radius) {
+	assert(l && position && radius >= 0.0F);
+
+	int min[3], max[3];
+
+	for(int k = 0; k < 3; k++) {
+		min[k] = (int)floorf((position[k] - radius) / LAYER_CHUNK_SIZE);
+		max[k] = (int)floorf((position[k] + radius) / LAYER_CHUNK_SIZE);
+	}
+
+	for(int z = min[2]; z <= max[2]; z++) {
+		for(int y = min[1]; y <= max[1]; y++) {
+			for(int x = min[0]; x <= max[0]; x++) {
+				struct layer_chunk* c
+					= ht_lookup(&l->chunks, (int[3]) {x, y, z});
+
+				if(c)
+					pager_touch(c);
+			}
+		}
+	}
 }
@@ -20,11 +20,20 @@
 #ifndef PINKED_LAYER_H
 #define PINKED_LAYER_H
 
+#include <cglm/cglm.h>
+
 #include "chunk.h"
 #include "hashtable.h"
 #include "input_stream.h"
 #include "output_stream.h"
 
+// chunk containing a voxel coordinate, rounds towards negative infinity
+#define LAYER_CHUNK_COORD(x)                                                   \
+	(((x) >= 0) ? ((x) / LAYER_CHUNK_SIZE) : (((x) + 1) / LAYER_CHUNK_SIZE - 1))
+#define LAYER_LOCAL_COORD(x) ((x) & (LAYER_CHUNK_SIZE - 1))
+// of the sphere around a chunk
+#define LAYER_CHUNK_RADIUS (LAYER_CHUNK_SIZE * 0.866F)
+
 enum layer_blend_mode {
 	KEEP_NONE = 0,
 	KEEP_AIR = 1,
@@ -32,6 +41,26 @@ enum layer_blend_mode {
 	SUBTRACT_SOLID = 3,
 };
 
+// neighborhood of a removed chunk must be baked again, see light.h
+struct layer_removed_chunk {
+	int x, y, z;
+	uint16_t columns[LAYER_CHUNK_SIZE];
+};
+
+/*
+	Light work left for the next light_update(). Allocated, chunks of the
+	layer point to it to queue themselves when their light changes.
+*/
+struct layer_light {
+	struct layer_removed_chunk* removed;
+	size_t length;
+	size_t capacity;
+	// chunks with changed blocks or dirty light, each listed once
+	struct layer_chunk** queue;
+	size_t queued;
+	size_t queue_capacity;
+};
+
 struct layer {
 	int x, y, z;
 	size_t sx, sy, sz;
@@ -39,20 +68,76 @@ struct layer {
 	bool selected;
 	HashTable chunks;
 	enum layer_blend_mode blend;
+	// allocated, chunks keep pointing to it when the layer is moved
+	struct stats* stats;
+	struct layer_light* light;
+};
+
+struct layer_stats {
+	size_t solid_voxels;
+	size_t colors;
+	size_t chunks;
+	// blocks of each distinct payload once, detail levels and meshes
+	size_t memory;
+	// part of memory held in GPU buffers
+	size_t gpu_bytes;
+	// inclusive bounds of all solid voxels, only set if there are any
+	int min[3], max[3];
 };
 
+// keyed by int[3] chunk coordinates like the chunks of a layer
+void layer_chunk_table(HashTable* table, size_t value_size);
+
 void layer_create(struct layer* l, int x, int y, int z);
+void layer_copy(struct layer* dst, struct layer* src);
 void layer_destroy(struct layer* l);
 
+// interns all chunk payloads, identical chunks then share their memory
+void layer_share_chunks(struct layer* l);
+
+// by chunk coordinates, inserts an empty chunk if missing and create is set
+struct layer_chunk* layer_get_chunk(struct layer* l, int x, int y, int z,
+									bool create);
+// destroys a chunk, chunks must not stay in a layer once they are empty
+void layer_remove_chunk(struct layer* l, struct layer_chunk* c);
+
 void layer_set_air(struct layer* l, int x, int y, int z);
 void layer_set_solid(struct layer* l, int x, int y, int z, struct color color);
 
+/*
+	Statistics are kept up to date by every change of the layer and read in
+	constant time. After loading they are counted on the thread pool.
+*/
+void layer_stats(struct layer* l, struct layer_stats* stats);
+// counts voxels on the thread pool, bulk edits remove the chunks with sign
+// -1 before changing their blocks and add them back with 1 afterwards
+void layer_count_chunks(struct layer* l, struct layer_chunk** chunks,
+						size_t length, int sign);
+size_t layer_color_voxels(struct layer* l, struct color color);
+// calls back with every color of the layer and its number of solid voxels
+void layer_colors(struct layer* l, void* user,
+				  bool (*callback)(struct color color, size_t voxels,
+								   void* user));
+
 bool layer_is_solid(struct layer* l, int x, int y, int z);
 struct color layer_get_color(struct layer* l, int x, int y, int z);
 
 bool layer_read(struct layer* l, struct input_stream* in);
 void layer_write(struct layer* l, struct output_stream* out);
 
-void layer_render(struct layer* l);
+// all layers reference one table of unique chunk payloads
+struct layer* layers_read(struct input_stream* in, size_t* count);
+void layers_write(struct layer* l, size_t count, struct output_stream* out);
+
+/*
+	Draws chunks within the view sorted front to back by their distance, picks
+	a level of detail per chunk from its projected voxel size. Unordered
+	drawing is only there to measure overdraw against, see bench.c.
+*/
+void layer_render(struct layer* l, mat4 mvp);
+void layer_render_ordered(bool front_to_back);
+
+// loads paged out chunks around a position and keeps them resident
+void layer_prefetch(struct layer* l, vec3 position, float radius);
 
 #endif
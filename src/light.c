@@ -0,0 +1,539 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL.h>
+
+#include "light.h"
+#include "pager.h"
+#include "thread_pool.h"
+
+// one cell of border around a chunk
+#define LIGHT_PADDED (LAYER_CHUNK_SIZE + 2)
+#define LIGHT_INDEX(x, y, z)                                                   \
+	(((x) + 1) + (((y) + 1) * LIGHT_PADDED + ((z) + 1)) * LIGHT_PADDED)
+#define LIGHT_NEIGHBOR(x) (((x) < 0) ? 0 : ((x) < LAYER_CHUNK_SIZE) ? 1 : 2)
+
+// indexed by [sunlit][ambient occlusion], 3 is unoccluded
+static const uint8_t light_levels[2][4] = {
+	{84, 107, 130, 153},
+	{140, 179, 217, 255},
+};
+
+struct light_list {
+	struct layer_chunk** chunks;
+	size_t length;
+	size_t capacity;
+	int min_z, max_z;
+};
+
+/*
+	Inputs are copied when a bake is queued, edits on the main thread may
+	change the blocks of the chunk and its neighbors while it runs.
+*/
+struct light_job {
+	// NULL once the result is outdated, see light_cancel()
+	struct layer_chunk* chunk;
+	struct layer_chunk_block blocks[LAYER_CHUNK_VOLUME];
+	// only the border of one cell around the chunk, the rest by the bake
+	uint8_t solid[LIGHT_PADDED * LIGHT_PADDED * LIGHT_PADDED];
+	// columns covered by any chunk above, for the 3x3 chunks in the same z
+	uint16_t covered[9][LAYER_CHUNK_SIZE];
+	struct render_vertex* vertices;
+	size_t quads;
+	double ms;
+};
+
+struct light_batch {
+	struct thread_pool_batch batch;
+	struct light_job* jobs;
+	size_t length;
+	Uint64 start;
+	struct light_batch* next;
+};
+
+static struct light_stats stats;
+// queued or finished but not yet applied, newest first
+static struct light_batch* batches = NULL;
+
+static void light_list_add(struct light_list* list, struct layer_chunk* c) {
+	if(list->length == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->chunks = realloc(list->chunks,
+							   list->capacity * sizeof(struct layer_chunk*));
+		assert(list->chunks);
+	}
+
+	list->chunks[list->length++] = c;
+}
+
+static void light_mark(struct layer* l, int x, int y, int z) {
+	struct layer_chunk* c = ht_lookup(&l->chunks, (int[3]) {x, y, z});
+
+	if(c) {
+		light_cancel(c);
+		c->light.dirty = true;
+		layer_chunk_queue_light(c);
+	}
+}
+
+static void light_columns(struct layer_chunk* c, uint16_t* columns) {
+	memset(columns, 0, LAYER_CHUNK_SIZE * sizeof(uint16_t));
+
+	for(int z = 0; z < LAYER_CHUNK_SIZE; z++) {
+		for(int y = 0; y < LAYER_CHUNK_SIZE; y++) {
+			for(int x = 0; x < LAYER_CHUNK_SIZE; x++) {
+				if(c->payload->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid)
+					columns[y] |= 1 << x;
+			}
+		}
+	}
+}
+
+// marks all chunks whose baked mesh depends on the changed chunk
+static void light_invalidate(struct layer* l, int x, int y, int z,
+							 uint16_t* old_columns, uint16_t* new_columns,
+							 int min_z) {
+	for(int dz = -1; dz <= 1; dz++) {
+		for(int dy = -1; dy <= 1; dy++) {
+			for(int dx = -1; dx <= 1; dx++)
+				light_mark(l, x + dx, y + dy, z + dz);
+		}
+	}
+
+	uint16_t diff[LAYER_CHUNK_SIZE];
+	bool any = false;
+
+	for(int k = 0; k < LAYER_CHUNK_SIZE; k++) {
+		diff[k] = old_columns[k] ^ new_columns[k];
+		any = any || diff[k];
+	}
+
+	// shade changes travel down until a solid block of each column blocks it
+	for(int cz = z - 1; any && cz >= min_z; cz--) {
+		for(int dy = -1; dy <= 1; dy++) {
+			for(int dx = -1; dx <= 1; dx++)
+				light_mark(l, x + dx, y + dy, cz);
+		}
+
+		struct layer_chunk* c = ht_lookup(&l->chunks, (int[3]) {x, y, cz});
+
+		if(c) {
+			any = false;
+
+			for(int k = 0; k < LAYER_CHUNK_SIZE; k++) {
+				diff[k] &= ~c->light.columns[k];
+				any = any || diff[k];
+			}
+		}
+	}
+}
+
+static void light_gather(struct layer* l, struct light_job* j, int max_z) {
+	struct layer_chunk* c = j->chunk;
+	// of the 3x3x3 chunks around, x fastest, NULL for missing ones
+	struct layer_chunk_block* blocks[27];
+	// evicted neighbors are read without loading them back
+	struct layer_chunk_payload* peeked[27];
+
+	for(int k = 0; k < 27; k++) {
+		int key[3] = {c->x + k % 3 - 1, c->y + k / 3 % 3 - 1, c->z + k / 9 - 1};
+		struct layer_chunk* n = ht_lookup(&l->chunks, key);
+
+		peeked[k] = NULL;
+		blocks[k] = NULL;
+
+		if(n && layer_chunk_resident(n)) {
+			blocks[k] = n->payload->blocks;
+		} else if(n) {
+			peeked[k] = pager_peek(n);
+			blocks[k] = peeked[k]->blocks;
+		}
+	}
+
+	memcpy(j->blocks, c->payload->blocks, sizeof(j->blocks));
+
+	for(int z = -1; z <= LAYER_CHUNK_SIZE; z++) {
+		for(int y = -1; y <= LAYER_CHUNK_SIZE; y++) {
+			for(int x = -1; x <= LAYER_CHUNK_SIZE; x++) {
+				int n = LIGHT_NEIGHBOR(x)
+					+ (LIGHT_NEIGHBOR(y) + LIGHT_NEIGHBOR(z) * 3) * 3;
+
+				if(n == 13)
+					continue;
+
+				j->solid[LIGHT_INDEX(x, y, z)] = blocks[n]
+					&& blocks[n][LAYER_CHUNK_INDEX(LAYER_LOCAL_COORD(x),
+												   LAYER_LOCAL_COORD(y),
+												   LAYER_LOCAL_COORD(z))]
+						   .solid;
+			}
+		}
+	}
+
+	for(int k = 0; k < 27; k++) {
+		if(peeked[k])
+			payload_unref(peeked[k]);
+	}
+
+	// evicted chunks keep their columns, no need to load them
+	for(int k = 0; k < 9; k++) {
+		memset(j->covered[k], 0, sizeof(j->covered[k]));
+
+		for(int cz = c->z + 1; cz <= max_z; cz++) {
+			struct layer_chunk* n = ht_lookup(
+				&l->chunks, (int[3]) {c->x + k % 3 - 1, c->y + k / 3 - 1, cz});
+
+			if(n) {
+				for(int i = 0; i < LAYER_CHUNK_SIZE; i++)
+					j->covered[k][i] |= n->light.columns[i];
+			}
+		}
+	}
+}
+
+// 0 is fully occluded, 3 if none of the three cells touching the corner
+static int light_occlusion(uint8_t* solid, int* front, int* du, int* dv) {
+	int side1 = solid[LIGHT_INDEX(front[0] + du[0], front[1] + du[1],
+								  front[2] + du[2])];
+	int side2 = solid[LIGHT_INDEX(front[0] + dv[0], front[1] + dv[1],
+								  front[2] + dv[2])];
+	int corner = solid[LIGHT_INDEX(front[0] + du[0] + dv[0],
+								   front[1] + du[1] + dv[1],
+								   front[2] + du[2] + dv[2])];
+
+	return (side1 && side2) ? 0 : 3 - side1 - side2 - corner;
+}
+
+// runs on the thread pool, only touches the job
+static void light_bake(size_t job, void* user) {
+	struct light_job* j = (struct light_job*)user + job;
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	uint8_t* solid = j->solid;
+	uint8_t lit[LIGHT_PADDED * LIGHT_PADDED * LIGHT_PADDED];
+
+	for(int z = 0; z < LAYER_CHUNK_SIZE; z++) {
+		for(int y = 0; y < LAYER_CHUNK_SIZE; y++) {
+			for(int x = 0; x < LAYER_CHUNK_SIZE; x++) {
+				solid[LIGHT_INDEX(x, y, z)]
+					= j->blocks[LAYER_CHUNK_INDEX(x, y, z)].solid;
+			}
+		}
+	}
+
+	// cells below the chunk are only seen by bottom faces, never sunlit
+	for(int y = -1; y <= LAYER_CHUNK_SIZE; y++) {
+		for(int x = -1; x <= LAYER_CHUNK_SIZE; x++) {
+			bool shaded = (j->covered[LIGHT_NEIGHBOR(x) + LIGHT_NEIGHBOR(y) * 3]
+									 [LAYER_LOCAL_COORD(y)]
+						   >> LAYER_LOCAL_COORD(x))
+				& 1;
+
+			for(int z = LAYER_CHUNK_SIZE; z >= 0; z--) {
+				lit[LIGHT_INDEX(x, y, z)] = !shaded;
+
+				if(z < LAYER_CHUNK_SIZE)
+					shaded = shaded || solid[LIGHT_INDEX(x, y, z)];
+			}
+		}
+	}
+
+	uint8_t exposed[LAYER_CHUNK_VOLUME];
+	size_t quads = 0;
+
+	for(int z = 0; z < LAYER_CHUNK_SIZE; z++) {
+		for(int y = 0; y < LAYER_CHUNK_SIZE; y++) {
+			for(int x = 0; x < LAYER_CHUNK_SIZE; x++) {
+				uint8_t faces = 0;
+
+				for(int face = 0; face < 6 && solid[LIGHT_INDEX(x, y, z)];
+					face++) {
+					const int* n = render_face_normals[face];
+
+					if(!solid[LIGHT_INDEX(x + n[0], y + n[1], z + n[2])]) {
+						faces |= 1 << face;
+						quads++;
+					}
+				}
+
+				exposed[LAYER_CHUNK_INDEX(x, y, z)] = faces;
+			}
+		}
+	}
+
+	assert(quads <= RENDER_MAX_QUADS);
+
+	struct render_vertex* out
+		= quads ? malloc(quads * 4 * sizeof(struct render_vertex)) : NULL;
+	assert(out || !quads);
+
+	j->vertices = out;
+	j->quads = quads;
+
+	for(int z = 0; z < LAYER_CHUNK_SIZE; z++) {
+		for(int y = 0; y < LAYER_CHUNK_SIZE; y++) {
+			for(int x = 0; x < LAYER_CHUNK_SIZE; x++) {
+				size_t index = LAYER_CHUNK_INDEX(x, y, z);
+
+				if(!exposed[index])
+					continue;
+
+				uint16_t color = render_pack_color(j->blocks[index].color);
+
+				for(int face = 0; face < 6; face++) {
+					if(!(exposed[index] & (1 << face)))
+						continue;
+
+					int axis = face / 2;
+					int u = (axis + 1) % 3;
+					int v = (axis + 2) % 3;
+					// cell in front of the face
+					int front[3] = {x + render_face_normals[face][0],
+									y + render_face_normals[face][1],
+									z + render_face_normals[face][2]};
+					int base[3] = {x, y, z};
+
+					if(face & 1)
+						base[axis]++;
+
+					bool sun = face != FACE_BOTTOM
+						&& lit[LIGHT_INDEX(front[0], front[1], front[2])];
+					struct render_vertex quad[4];
+
+					for(int k = 0; k < 4; k++) {
+						int du[3] = {0, 0, 0};
+						int dv[3] = {0, 0, 0};
+						du[u] = render_face_corners[face & 1][k][0] * 2 - 1;
+						dv[v] = render_face_corners[face & 1][k][1] * 2 - 1;
+
+						int ao = light_occlusion(solid, front, du, dv);
+						int pos[3] = {base[0], base[1], base[2]};
+						pos[u] += render_face_corners[face & 1][k][0];
+						pos[v] += render_face_corners[face & 1][k][1];
+
+						quad[k] = (struct render_vertex) {
+							.x = pos[0],
+							.y = pos[1],
+							.z = pos[2],
+							.face = face,
+							.color = color,
+							.light = light_levels[sun][ao],
+						};
+					}
+
+					// split along the brighter diagonal, keeps gradients even
+					int flip = quad[0].light + quad[2].light
+						< quad[1].light + quad[3].light;
+
+					for(int k = 0; k < 4; k++)
+						*out++ = quad[(k + flip) % 4];
+				}
+			}
+		}
+	}
+
+	j->ms = (double)(SDL_GetPerformanceCounter() - start) * 1000.0
+		/ SDL_GetPerformanceFrequency();
+}
+
+// applies the results of finished bakes to their chunks
+static void light_collect(bool wait) {
+	struct light_batch** link = &batches;
+
+	while(*link) {
+		struct light_batch* b = *link;
+
+		if(wait)
+			thread_pool_wait(&b->batch);
+
+		if(!thread_pool_done(&b->batch)) {
+			link = &b->next;
+			continue;
+		}
+
+		for(size_t k = 0; k < b->length; k++) {
+			struct light_job* j = b->jobs + k;
+			struct layer_chunk* c = j->chunk;
+
+			stats.chunk_ms += j->ms;
+
+			if(j->ms > stats.max_chunk_ms)
+				stats.max_chunk_ms = j->ms;
+
+			if(!c) {
+				free(j->vertices);
+				continue;
+			}
+
+			// a bake may replace one that was never uploaded
+			free(c->light.vertices);
+			c->light.vertices = j->vertices;
+			c->light.quads = j->quads;
+			c->light.pending = true;
+			c->light.dirty = false;
+			c->light.job = NULL;
+			layer_chunk_account(c);
+		}
+
+		stats.chunks += b->length;
+		stats.last_chunks = b->length;
+		stats.last_ms = (double)(SDL_GetPerformanceCounter() - b->start)
+			* 1000.0 / SDL_GetPerformanceFrequency();
+
+		*link = b->next;
+		free(b->jobs);
+		free(b);
+	}
+}
+
+void light_cancel(struct layer_chunk* c) {
+	assert(c);
+
+	if(c->light.job) {
+		c->light.job->chunk = NULL;
+		c->light.job = NULL;
+	}
+}
+
+void light_wait(void) {
+	light_collect(true);
+}
+
+bool light_busy(void) {
+	return batches != NULL;
+}
+
+bool light_ready(void) {
+	for(struct light_batch* b = batches; b; b = b->next) {
+		if(thread_pool_done(&b->batch))
+			return true;
+	}
+
+	return false;
+}
+
+void light_update(struct layer* l) {
+	assert(l);
+
+	light_collect(false);
+
+	Uint64 start = SDL_GetPerformanceCounter();
+
+	struct light_list list = {
+		.chunks = NULL,
+		.length = 0,
+		.capacity = 0,
+		.min_z = INT_MAX,
+		.max_z = INT_MIN,
+	};
+
+	struct layer_light* q = l->light;
+	int min[3], max[3];
+
+	// only chunks with solid blocks cast or receive shade
+	if(stats_bounds(l->stats, min, max)) {
+		list.min_z = LAYER_CHUNK_COORD(min[2]);
+		list.max_z = LAYER_CHUNK_COORD(max[2]);
+	}
+
+	for(size_t k = 0; k < q->queued; k++) {
+		if(q->queue[k]->light.changed)
+			light_list_add(&list, q->queue[k]);
+	}
+
+	uint16_t(*old_columns)[LAYER_CHUNK_SIZE]
+		= malloc((list.length + 1) * sizeof(*old_columns));
+	assert(old_columns);
+
+	// all columns must be current before any chunk below is invalidated
+	for(size_t k = 0; k < list.length; k++) {
+		struct layer_chunk* c = list.chunks[k];
+		pager_touch(c);
+		memcpy(old_columns[k], c->light.columns, sizeof(old_columns[k]));
+		light_columns(c, c->light.columns);
+		c->light.changed = false;
+	}
+
+	for(size_t k = 0; k < list.length; k++) {
+		struct layer_chunk* c = list.chunks[k];
+		light_invalidate(l, c->x, c->y, c->z, old_columns[k],
+						 c->light.columns, list.min_z);
+	}
+
+	free(old_columns);
+
+	uint16_t none[LAYER_CHUNK_SIZE] = {0};
+
+	for(size_t k = 0; k < q->length; k++) {
+		struct layer_removed_chunk* r = q->removed + k;
+		light_invalidate(l, r->x, r->y, r->z, r->columns, none, list.min_z);
+	}
+
+	q->length = 0;
+	list.length = 0;
+
+	// queued bakes and evicted chunks are listed again once they change or
+	// are loaded back, see layer_chunk_queue_light()
+	for(size_t k = 0; k < q->queued; k++) {
+		struct layer_chunk* c = q->queue[k];
+		c->light.queued = false;
+
+		if(c->light.dirty && !c->light.job && layer_chunk_resident(c))
+			light_list_add(&list, c);
+	}
+
+	q->queued = 0;
+
+	if(list.length > 0) {
+		struct light_batch* b = malloc(sizeof(struct light_batch));
+		assert(b);
+
+		b->jobs = malloc(list.length * sizeof(struct light_job));
+		assert(b->jobs);
+
+		b->length = list.length;
+		b->start = start;
+
+		for(size_t k = 0; k < list.length; k++) {
+			struct light_job* j = b->jobs + k;
+			j->chunk = list.chunks[k];
+			j->chunk->light.job = j;
+			light_gather(l, j, list.max_z);
+		}
+
+		b->next = batches;
+		batches = b;
+		thread_pool_start(&b->batch, b->length, light_bake, b->jobs);
+	}
+
+	free(list.chunks);
+
+	// without worker threads the bakes are already done
+	light_collect(false);
+}
+
+void light_stats(struct light_stats* s) {
+	assert(s);
+	*s = stats;
+}
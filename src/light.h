@@ -0,0 +1,60 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_LIGHT_H
+#define PINKED_LIGHT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "layer.h"
+
+struct light_stats {
+	// summed over all bakes since startup
+	size_t chunks;
+	double chunk_ms;
+	double max_chunk_ms;
+	// wall time from queueing the last batch of bakes to its result
+	size_t last_chunks;
+	double last_ms;
+};
+
+/*
+	Bakes the level 0 mesh of a chunk with per vertex ambient occlusion and
+	top-down sunlight. Both look at the blocks of all 26 neighbor chunks, a
+	face is sunlit if no solid block is above the cell in front of it.
+	Faces hidden by a neighbor chunk are culled as well.
+
+	An edit rebakes the chunk, its neighbors and, if the set of solid
+	columns changed, the chunks below it that it now shades or stopped
+	shading. Called by layer_render(), bakes are queued on the thread pool
+	in the background. Until the result of a later call is ready edited
+	chunks show an unlit mesh, all others keep their previous one.
+*/
+void light_update(struct layer* l);
+// drops a queued bake, its chunk changed again or is destroyed
+void light_cancel(struct layer_chunk* c);
+// blocks until all queued bakes are done, needed before shutdown
+void light_wait(void);
+// any bakes queued, ready if one of them is done and can be applied
+bool light_busy(void);
+bool light_ready(void);
+void light_stats(struct light_stats* stats);
+
+#endif
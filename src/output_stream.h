@@ -31,6 +31,7 @@ struct output_stream {
 };
 
 void outs_create(struct output_stream* out);
+void outs_destroy(struct output_stream* out);
 
 void outs_write32s(struct output_stream* out, int32_t x);
 void outs_write32u(struct output_stream* out, uint32_t x);
@@ -0,0 +1,236 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chunk.h"
+#include "pager.h"
+
+// chunks used within this many frames are never evicted
+#define PAGER_MIN_AGE 2
+
+static struct {
+	bool enabled;
+	FILE* store;
+	size_t frame;
+	// most recently used first
+	struct layer_chunk* head;
+	struct layer_chunk* tail;
+	// offsets of store slots released by destroyed chunks
+	long* free_slots;
+	size_t free_length, free_capacity;
+	struct pager_stats stats;
+} pager;
+
+static void pager_link(struct layer_chunk* c) {
+	c->page.prev = NULL;
+	c->page.next = pager.head;
+
+	if(pager.head)
+		pager.head->page.prev = c;
+	else
+		pager.tail = c;
+
+	pager.head = c;
+	c->page.linked = true;
+	c->page.last_use = pager.frame;
+}
+
+static void pager_unlink(struct layer_chunk* c) {
+	if(c->page.prev)
+		c->page.prev->page.next = c->page.next;
+	else
+		pager.head = c->page.next;
+
+	if(c->page.next)
+		c->page.next->page.prev = c->page.prev;
+	else
+		pager.tail = c->page.prev;
+
+	c->page.linked = false;
+}
+
+bool pager_init(const char* path, size_t budget) {
+	assert(!pager.enabled);
+
+	pager.store = path ? fopen(path, "w+b") : tmpfile();
+
+	if(!pager.store)
+		return false;
+
+	pager.enabled = true;
+	pager.frame = 0;
+	pager.head = pager.tail = NULL;
+	pager.free_slots = NULL;
+	pager.free_length = pager.free_capacity = 0;
+	pager.stats = (struct pager_stats) {.budget = budget};
+
+	return true;
+}
+
+void pager_destroy(void) {
+	if(!pager.enabled)
+		return;
+
+	while(pager.head)
+		pager_unlink(pager.head);
+
+	free(pager.free_slots);
+	fclose(pager.store);
+	pager.enabled = false;
+}
+
+bool pager_enabled(void) {
+	return pager.enabled;
+}
+
+void pager_track(struct layer_chunk* c) {
+	assert(c);
+
+	if(pager.enabled && !c->page.linked)
+		pager_link(c);
+}
+
+void pager_forget(struct layer_chunk* c) {
+	assert(c);
+
+	if(c->page.linked)
+		pager_unlink(c);
+
+	if(c->page.offset >= 0) {
+		if(pager.free_length == pager.free_capacity) {
+			pager.free_capacity
+				= pager.free_capacity ? pager.free_capacity * 2 : 64;
+			pager.free_slots = realloc(pager.free_slots,
+									   pager.free_capacity * sizeof(long));
+			assert(pager.free_slots);
+		}
+
+		pager.free_slots[pager.free_length++] = c->page.offset;
+		c->page.offset = -1;
+	}
+}
+
+static struct layer_chunk_payload* pager_read(struct layer_chunk* c) {
+	assert(c->page.offset >= 0);
+
+	uint8_t* data = malloc(PAYLOAD_SERIALIZED_SIZE);
+	assert(data);
+
+	fseek(pager.store, c->page.offset, SEEK_SET);
+	size_t read = fread(data, PAYLOAD_SERIALIZED_SIZE, 1, pager.store);
+	assert(read == 1);
+
+	struct input_stream in;
+	ins_create(&in, PAYLOAD_SERIALIZED_SIZE, data);
+	struct layer_chunk_payload* payload = payload_read(&in);
+	free(data);
+
+	pager.stats.bytes_read += PAYLOAD_SERIALIZED_SIZE;
+
+	return payload;
+}
+
+static void pager_load(struct layer_chunk* c) {
+	layer_chunk_restore(c, payload_share(pager_read(c)));
+	pager.stats.misses++;
+}
+
+struct layer_chunk_payload* pager_peek(struct layer_chunk* c) {
+	assert(c && !layer_chunk_resident(c));
+	return pager_read(c);
+}
+
+static void pager_store(struct layer_chunk* c) {
+	struct output_stream out;
+	outs_create(&out);
+	payload_write(c->payload, &out);
+
+	// each chunk keeps its slot, all slots have the same size
+	if(c->page.offset < 0 && pager.free_length > 0) {
+		c->page.offset = pager.free_slots[--pager.free_length];
+	} else if(c->page.offset < 0) {
+		fseek(pager.store, 0, SEEK_END);
+		c->page.offset = ftell(pager.store);
+	}
+
+	fseek(pager.store, c->page.offset, SEEK_SET);
+	outs_save(&out, pager.store);
+	outs_destroy(&out);
+
+	c->page.dirty = false;
+	pager.stats.bytes_written += PAYLOAD_SERIALIZED_SIZE;
+}
+
+void pager_touch(struct layer_chunk* c) {
+	assert(c);
+
+	if(!pager.enabled)
+		return;
+
+	if(layer_chunk_resident(c)) {
+		pager.stats.hits++;
+	} else {
+		pager_load(c);
+	}
+
+	if(c->page.linked)
+		pager_unlink(c);
+
+	pager_link(c);
+}
+
+void pager_collect(void) {
+	if(!pager.enabled)
+		return;
+
+	pager.stats.resident_chunks = 0;
+	pager.stats.resident_bytes = 0;
+
+	for(struct layer_chunk* c = pager.head; c; c = c->page.next) {
+		pager.stats.resident_chunks++;
+		pager.stats.resident_bytes += layer_chunk_memory(c);
+	}
+
+	while(pager.tail && pager.stats.resident_bytes > pager.stats.budget
+		  && pager.frame - pager.tail->page.last_use >= PAGER_MIN_AGE) {
+		struct layer_chunk* c = pager.tail;
+		size_t bytes = layer_chunk_memory(c);
+
+		// unmodified chunks already have a valid copy in the store
+		if(c->page.dirty || c->page.offset < 0)
+			pager_store(c);
+
+		pager_unlink(c);
+		layer_chunk_evict(c);
+
+		pager.stats.evictions++;
+		pager.stats.resident_chunks--;
+		pager.stats.resident_bytes -= bytes;
+	}
+
+	pager.frame++;
+}
+
+void pager_stats(struct pager_stats* stats) {
+	assert(stats);
+	*stats = pager.stats;
+}
@@ -0,0 +1,69 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_PAGER_H
+#define PINKED_PAGER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct layer_chunk;
+struct layer_chunk_payload;
+
+struct pager_stats {
+	size_t hits;
+	size_t misses;
+	size_t evictions;
+	size_t bytes_written;
+	size_t bytes_read;
+	size_t resident_chunks;
+	size_t resident_bytes;
+	size_t budget;
+};
+
+/*
+	Paging keeps a least recently used list of all resident chunks. Chunks
+	that were not touched for some frames are written to a chunk store file
+	and evicted once the resident memory exceeds the budget. Their GPU
+	buffers are released too. Evicted chunks keep their position and solid
+	count, any layer_* access loads them back transparently.
+
+	Not thread-safe, main thread only.
+*/
+
+// path may be NULL for an anonymous temporary file
+bool pager_init(const char* path, size_t budget);
+// evicted chunks can't be loaded anymore, destroy all layers first
+void pager_destroy(void);
+bool pager_enabled(void);
+
+// starts tracking a chunk at its final memory location
+void pager_track(struct layer_chunk* c);
+// stops tracking a destroyed chunk, its slot in the store is reused
+void pager_forget(struct layer_chunk* c);
+// marks a chunk as recently used and loads it if it was evicted
+void pager_touch(struct layer_chunk* c);
+// reads the blocks of an evicted chunk, which stays evicted, unref when done
+struct layer_chunk_payload* pager_peek(struct layer_chunk* c);
+
+// call once per frame, evicts chunks until the budget is met
+void pager_collect(void);
+void pager_stats(struct pager_stats* stats);
+
+#endif
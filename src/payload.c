@@ -0,0 +1,284 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload.h"
+
+static HashTable shared_payloads;
+static bool shared_payloads_init = false;
+static size_t shared_references = 0;
+static size_t private_payloads = 0;
+
+static int payload_compare(void* a, void* b, size_t key_size) {
+	assert(a && b && key_size == sizeof(struct layer_chunk_payload*));
+	struct layer_chunk_payload* A = *(struct layer_chunk_payload**)a;
+	struct layer_chunk_payload* B = *(struct layer_chunk_payload**)b;
+
+	return A->hash != B->hash
+		|| memcmp(A->blocks, B->blocks, sizeof(A->blocks)) != 0;
+}
+
+static size_t payload_hash_callback(void* a, size_t key_size) {
+	assert(a && key_size == sizeof(struct layer_chunk_payload*));
+	return (*(struct layer_chunk_payload**)a)->hash;
+}
+
+static uint32_t payload_hash(struct layer_chunk_payload* p) {
+	uint32_t h = 0x811C9DC5;
+
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		struct layer_chunk_block* b = p->blocks + k;
+		h = (h ^ (b->solid | (b->color.red << 8) | (b->color.green << 16)
+				  | ((uint32_t)b->color.blue << 24)))
+			* 0x01000193;
+	}
+
+	h = ((h >> 16) ^ h) * 0x45D9F3B;
+	return (h >> 16) ^ h;
+}
+
+static void payload_setup(void) {
+	if(!shared_payloads_init) {
+		ht_setup(&shared_payloads, sizeof(struct layer_chunk_payload*),
+				 sizeof(struct layer_chunk_payload*), 256);
+		shared_payloads.compare = payload_compare;
+		shared_payloads.hash = payload_hash_callback;
+		shared_payloads_init = true;
+	}
+}
+
+struct layer_chunk_payload* payload_create(void) {
+	struct layer_chunk_payload* p = malloc(sizeof(struct layer_chunk_payload));
+	assert(p);
+
+	p->references = 1;
+	p->hash = 0;
+	p->shared = false;
+	memset(p->blocks, 0, sizeof(p->blocks));
+
+	private_payloads++;
+
+	return p;
+}
+
+struct layer_chunk_payload* payload_ref(struct layer_chunk_payload* p) {
+	// private payloads have exactly one owner
+	assert(p && p->shared);
+
+	p->references++;
+	shared_references++;
+
+	return p;
+}
+
+void payload_unref(struct layer_chunk_payload* p) {
+	assert(p && p->references > 0);
+
+	p->references--;
+
+	if(p->shared)
+		shared_references--;
+
+	if(!p->references) {
+		if(p->shared) {
+			ht_erase(&shared_payloads, &p);
+		} else {
+			private_payloads--;
+		}
+
+		free(p);
+	}
+}
+
+struct layer_chunk_payload* payload_share(struct layer_chunk_payload* p) {
+	assert(p);
+
+	if(p->shared)
+		return p;
+
+	payload_setup();
+	p->hash = payload_hash(p);
+
+	struct layer_chunk_payload** existing = ht_lookup(&shared_payloads, &p);
+
+	if(existing) {
+		payload_unref(p);
+		return payload_ref(*existing);
+	}
+
+	p->shared = true;
+	private_payloads--;
+	shared_references++;
+	ht_insert(&shared_payloads, &p, &p);
+
+	return p;
+}
+
+struct layer_chunk_payload* payload_unique(struct layer_chunk_payload* p) {
+	assert(p);
+
+	if(!p->shared)
+		return p;
+
+	// the last owner takes the interned payload back instead of copying it
+	if(p->references == 1) {
+		ht_erase(&shared_payloads, &p);
+		p->shared = false;
+		shared_references--;
+		private_payloads++;
+
+		return p;
+	}
+
+	struct layer_chunk_payload* copy = payload_create();
+	memcpy(copy->blocks, p->blocks, sizeof(p->blocks));
+	payload_unref(p);
+
+	return copy;
+}
+
+void payload_stats(struct payload_stats* stats) {
+	assert(stats);
+
+	stats->shared = shared_payloads_init ? shared_payloads.size : 0;
+	stats->references = shared_references;
+	stats->private = private_payloads;
+	stats->bytes_resident = (stats->shared + stats->private)
+		* sizeof(struct layer_chunk_payload);
+	stats->bytes_saved = (stats->references - stats->shared)
+		* sizeof(struct layer_chunk_payload);
+}
+
+void payload_write(struct layer_chunk_payload* p, struct output_stream* out) {
+	assert(p && out);
+
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		outs_write8u(out, p->blocks[k].solid);
+		outs_write8u(out, p->blocks[k].color.red);
+		outs_write8u(out, p->blocks[k].color.green);
+		outs_write8u(out, p->blocks[k].color.blue);
+	}
+}
+
+struct layer_chunk_payload* payload_read(struct input_stream* in) {
+	assert(in && ins_available(in) >= PAYLOAD_SERIALIZED_SIZE);
+
+	struct layer_chunk_payload* p = payload_create();
+
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		p->blocks[k].solid = ins_read8u(in);
+		p->blocks[k].color.red = ins_read8u(in);
+		p->blocks[k].color.green = ins_read8u(in);
+		p->blocks[k].color.blue = ins_read8u(in);
+
+		if(!p->blocks[k].solid)
+			p->blocks[k].color = (struct color) {0, 0, 0};
+	}
+
+	return p;
+}
+
+void payload_index_create(struct payload_index* index) {
+	assert(index);
+
+	ht_setup(&index->lookup, sizeof(struct layer_chunk_payload*),
+			 sizeof(uint32_t), 256);
+	index->length = 0;
+	index->capacity = 64;
+	index->payloads
+		= malloc(index->capacity * sizeof(struct layer_chunk_payload*));
+	assert(index->payloads);
+}
+
+void payload_index_destroy(struct payload_index* index) {
+	assert(index);
+
+	ht_destroy(&index->lookup);
+	free(index->payloads);
+}
+
+uint32_t payload_index_add(struct payload_index* index,
+						   struct layer_chunk_payload* p) {
+	assert(index && p);
+
+	uint32_t* existing = ht_lookup(&index->lookup, &p);
+
+	if(existing)
+		return *existing;
+
+	if(index->length >= index->capacity) {
+		index->capacity *= 2;
+		index->payloads = realloc(
+			index->payloads,
+			index->capacity * sizeof(struct layer_chunk_payload*));
+		assert(index->payloads);
+	}
+
+	uint32_t id = index->length++;
+	index->payloads[id] = p;
+	ht_insert(&index->lookup, &p, &id);
+
+	return id;
+}
+
+void payload_index_write(struct payload_index* index,
+						 struct output_stream* out) {
+	assert(index && out);
+
+	outs_write32u(out, index->length);
+
+	for(size_t k = 0; k < index->length; k++)
+		payload_write(index->payloads[k], out);
+}
+
+struct layer_chunk_payload** payload_table_read(struct input_stream* in,
+												size_t* length) {
+	assert(in && length);
+
+	if(ins_available(in) < sizeof(uint32_t))
+		return NULL;
+
+	*length = ins_read32u(in);
+
+	if(ins_available(in) / PAYLOAD_SERIALIZED_SIZE < *length)
+		return NULL;
+
+	struct layer_chunk_payload** payloads
+		= malloc((*length + 1) * sizeof(struct layer_chunk_payload*));
+	assert(payloads);
+
+	// merges with identical payloads already loaded, e.g. other projects
+	for(size_t k = 0; k < *length; k++)
+		payloads[k] = payload_share(payload_read(in));
+
+	return payloads;
+}
+
+void payload_table_destroy(struct layer_chunk_payload** payloads,
+						   size_t length) {
+	assert(payloads);
+
+	for(size_t k = 0; k < length; k++)
+		payload_unref(payloads[k]);
+
+	free(payloads);
+}
@@ -0,0 +1,106 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_PAYLOAD_H
+#define PINKED_PAYLOAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "hashtable.h"
+#include "input_stream.h"
+#include "output_stream.h"
+
+// must be power of 2
+#define LAYER_CHUNK_SIZE 16
+#define LAYER_CHUNK_VOLUME                                                     \
+	(LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE)
+
+#define LAYER_CHUNK_INDEX(x, y, z)                                             \
+	((x) + ((y)*LAYER_CHUNK_SIZE + (z)) * LAYER_CHUNK_SIZE)
+
+struct layer_chunk_block {
+	bool solid;
+	struct color color;
+};
+
+/*
+	Block data of a chunk. A payload is either private to a single chunk and
+	may be edited in place, or shared: then it is immutable, interned by its
+	content hash and referenced by any number of chunks (of any layer).
+	Air blocks always have a zero color, so equal content is equal memory.
+
+	None of these functions are thread-safe, only call them from the main
+	thread.
+*/
+struct layer_chunk_payload {
+	size_t references;
+	uint32_t hash;
+	bool shared;
+	struct layer_chunk_block blocks[LAYER_CHUNK_VOLUME];
+};
+
+#define PAYLOAD_SERIALIZED_SIZE (LAYER_CHUNK_VOLUME * 4 * sizeof(uint8_t))
+
+struct payload_stats {
+	size_t shared;
+	size_t references;
+	size_t private;
+	size_t bytes_resident;
+	size_t bytes_saved;
+};
+
+// maps payloads to consecutive indices while saving
+struct payload_index {
+	HashTable lookup;
+	struct layer_chunk_payload** payloads;
+	size_t length;
+	size_t capacity;
+};
+
+struct layer_chunk_payload* payload_create(void);
+struct layer_chunk_payload* payload_ref(struct layer_chunk_payload* p);
+void payload_unref(struct layer_chunk_payload* p);
+
+// consumes the passed reference, returns a reference to the interned copy
+struct layer_chunk_payload* payload_share(struct layer_chunk_payload* p);
+// consumes the passed reference, returns a reference to an editable payload
+struct layer_chunk_payload* payload_unique(struct layer_chunk_payload* p);
+
+void payload_stats(struct payload_stats* stats);
+
+void payload_write(struct layer_chunk_payload* p, struct output_stream* out);
+// returns a private payload
+struct layer_chunk_payload* payload_read(struct input_stream* in);
+
+void payload_index_create(struct payload_index* index);
+void payload_index_destroy(struct payload_index* index);
+uint32_t payload_index_add(struct payload_index* index,
+						   struct layer_chunk_payload* p);
+void payload_index_write(struct payload_index* index,
+						 struct output_stream* out);
+
+struct layer_chunk_payload** payload_table_read(struct input_stream* in,
+												size_t* length);
+void payload_table_destroy(struct layer_chunk_payload** payloads,
+						   size_t length);
+
+#endif
@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <cglm/cglm.h>
 
@@ -8,7 +10,13 @@
 #undef main
 
 #include "bitmap.h"
+#include "camera.h"
+#include "edit_batch.h"
 #include "layer.h"
+#include "light.h"
+#include "pager.h"
+#include "render.h"
+#include "thread_pool.h"
 
 static void check_gl_errors_helper(const char* file, int line) {
 	while(1) {
@@ -30,6 +38,74 @@ static void check_gl_errors_helper(const char* file, int line) {
 
 #define CHECK_GL_ERRORS(func) func, check_gl_errors_helper(__FILE__, __LINE__)
 
+// longest time to sleep without any event, pending work is picked up after
+#define IDLE_TIMEOUT_MS 250
+// checks back this often while light is baked in the background
+#define BAKE_POLL_MS 10
+#define CAMERA_SPEED 64.0F
+
+struct editor {
+	bool quit;
+	bool redraw;
+	int width, height;
+	bool dragging;
+	struct camera camera;
+};
+
+static void editor_event(struct editor* e, SDL_Event* event) {
+	switch(event->type) {
+		case SDL_QUIT: e->quit = true; break;
+		case SDL_WINDOWEVENT:
+			switch(event->window.event) {
+				case SDL_WINDOWEVENT_CLOSE: e->quit = true; break;
+				case SDL_WINDOWEVENT_RESIZED:
+				case SDL_WINDOWEVENT_SIZE_CHANGED:
+					e->width = event->window.data1;
+					e->height = event->window.data2;
+					glViewport(0, 0, e->width, e->height);
+					e->redraw = true;
+					break;
+				case SDL_WINDOWEVENT_SHOWN:
+				case SDL_WINDOWEVENT_EXPOSED:
+				case SDL_WINDOWEVENT_RESTORED: e->redraw = true; break;
+			}
+			break;
+		case SDL_MOUSEBUTTONDOWN:
+		case SDL_MOUSEBUTTONUP:
+			if(event->button.button == SDL_BUTTON_LEFT)
+				e->dragging = event->type == SDL_MOUSEBUTTONDOWN;
+			break;
+		case SDL_MOUSEMOTION:
+			if(e->dragging) {
+				camera_rotate(&e->camera, event->motion.xrel * -0.005F,
+							  event->motion.yrel * 0.005F);
+				e->redraw = true;
+			}
+			break;
+		case SDL_MOUSEWHEEL:
+			if(event->wheel.y) {
+				camera_zoom(&e->camera, event->wheel.y > 0 ? 0.9F : 1.1F);
+				e->redraw = true;
+			}
+			break;
+	}
+}
+
+// returns true while a movement key is held, those need continuous frames
+static bool editor_move(struct editor* e, float dt) {
+	const Uint8* keys = SDL_GetKeyboardState(NULL);
+	float forward = keys[SDL_SCANCODE_W] - keys[SDL_SCANCODE_S];
+	float right = keys[SDL_SCANCODE_D] - keys[SDL_SCANCODE_A];
+	float up = keys[SDL_SCANCODE_E] - keys[SDL_SCANCODE_Q];
+
+	if(forward == 0.0F && right == 0.0F && up == 0.0F)
+		return false;
+
+	float speed = CAMERA_SPEED * dt * fmaxf(e->camera.distance / 128.0F, 1.0F);
+	camera_move(&e->camera, forward * speed, right * speed, up * speed);
+	return true;
+}
+
 int main(int argc, char** argv) {
 	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
 
@@ -59,91 +135,108 @@ int main(int argc, char** argv) {
 	glDepthFunc(GL_LEQUAL);
 	glClearColor(0.0F, 0.0F, 0.0F, 1.0F);
 
-	char* v_src = "#version 100\n"
-				  "uniform mat4 mvp;\n"
-				  "attribute vec3 v_pos;\n"
-				  "void main() {\n"
-				  "	gl_Position = mvp * vec4(v_pos, 1.0);\n"
-				  "}";
-	char* f_src = "#version 100\n"
-				  "void main() {\n"
-				  "	gl_FragColor = vec4(1.0, 0.0, 1.0, 1.0);"
-				  "}";
-
-	GLuint compile_status;
-	GLuint shader_v = glCreateShader(GL_VERTEX_SHADER);
-	GLuint shader_f = glCreateShader(GL_FRAGMENT_SHADER);
-	CHECK_GL_ERRORS(glShaderSource(shader_v, 1, (const GLchar**)&v_src,
-								   (GLuint[]) {strlen(v_src)}));
-	CHECK_GL_ERRORS(glShaderSource(shader_f, 1, (const GLchar**)&f_src,
-								   (GLuint[]) {strlen(f_src)}));
-
-	CHECK_GL_ERRORS(glCompileShader(shader_v));
-	glGetShaderiv(shader_v, GL_COMPILE_STATUS, &compile_status);
-	assert(compile_status == GL_TRUE);
-
-	CHECK_GL_ERRORS(glCompileShader(shader_f));
-	glGetShaderiv(shader_v, GL_COMPILE_STATUS, &compile_status);
-	assert(compile_status == GL_TRUE);
-
-	GLuint prog = glCreateProgram();
-	CHECK_GL_ERRORS(glAttachShader(prog, shader_v));
-	CHECK_GL_ERRORS(glAttachShader(prog, shader_f));
-	CHECK_GL_ERRORS(glLinkProgram(prog));
+	bool success = render_init();
+	assert(success);
 
+	GLuint prog = render_program();
 	CHECK_GL_ERRORS(glUseProgram(prog));
 
-	glBindAttribLocation(prog, 0, "v_pos");
-
-	bool quit = false;
+	for(int k = 1; k < argc - 1; k++) {
+		// resident chunk memory in MiB, chunks beyond are paged to disk
+		if(!strcmp(argv[k], "--page-budget")) {
+			if(!pager_init(NULL, (size_t)atoi(argv[k + 1]) * 1024 * 1024))
+				printf("could not create chunk store, paging disabled\n");
+		}
+	}
 
 	struct layer test;
 	layer_create(&test, 0, 0, 0);
 
+	struct edit_batch fill;
+	edit_batch_create(&fill);
+
 	for(int x = -256; x < 256; x++) {
 		for(int y = -256; y < 256; y++) {
 			for(int z = 0; z < 8; z++) {
-				layer_set_solid(&test, x, y, z, (struct color) {255, 0, 255});
+				edit_batch_set_solid(&fill, x, y, z,
+									 (struct color) {255, 0, 255});
 			}
 		}
 	}
 
-	while(!quit) {
+	edit_batch_apply(&fill, &test, NULL);
+	edit_batch_destroy(&fill);
+
+	struct editor editor = {.redraw = true};
+	SDL_GetWindowSize(window, &editor.width, &editor.height);
+	camera_create(&editor.camera, 0.0F, 0.0F, 8.0F);
+
+	size_t changes = layer_chunk_changes();
+	Uint32 last_frame = SDL_GetTicks();
+	bool moving = false;
+
+	while(!editor.quit) {
+		// sleep until something happens unless a frame is already due
+		int timeout = editor.redraw || moving ? 0 : IDLE_TIMEOUT_MS;
+
+		if(timeout && light_busy())
+			timeout = BAKE_POLL_MS;
+
 		SDL_Event event;
-		while(SDL_PollEvent(&event)) {
-			switch(event.type) {
-				case SDL_WINDOWEVENT:
-					switch(event.window.event) {
-						case SDL_WINDOWEVENT_CLOSE: quit = true; break;
-						case SDL_WINDOWEVENT_RESIZED:
-						case SDL_WINDOWEVENT_SIZE_CHANGED:
-							glViewport(0, 0, event.window.data1,
-									   event.window.data2);
-							break;
-					}
-					break;
-			}
+
+		if(SDL_WaitEventTimeout(&event, timeout)) {
+			editor_event(&editor, &event);
+
+			while(SDL_PollEvent(&event))
+				editor_event(&editor, &event);
 		}
 
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		Uint32 now = SDL_GetTicks();
+		float dt = (now - last_frame) / 1000.0F;
 
-		int8_t vertices[] = {0, 0, 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+		moving = editor_move(&editor, fminf(dt, 0.1F));
+		editor.redraw = editor.redraw || moving;
 
-		glUniformMatrix4fv(glGetUniformLocation(prog, "mvp"), 1, GL_FALSE,
-						   (float[]) {0.5, 0, 0, 0, 0, 0.5, 0, 0, 0, 0, 0.5, 0,
-									  -0.25, -0.25, 0, 1});
+		if(layer_chunk_changes() != changes) {
+			changes = layer_chunk_changes();
+			editor.redraw = true;
+		}
+
+		// the next frame uploads what is done
+		if(light_ready())
+			editor.redraw = true;
+
+		if(!editor.redraw || editor.width <= 0 || editor.height <= 0)
+			continue;
 
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 3, GL_BYTE, GL_FALSE, 0, vertices);
-		glDrawArrays(GL_LINES, 0, 4);
-		glDisableVertexAttribArray(0);
+		editor.redraw = false;
+		last_frame = now;
+
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		layer_render(&test);
+		mat4 mvp;
+		camera_matrix(&editor.camera, (float)editor.width / editor.height,
+					  mvp);
+		render_set_mvp(mvp);
+
+		if(pager_enabled()) {
+			vec3 position;
+			camera_position(&editor.camera, position);
+			layer_prefetch(&test, position, editor.camera.distance);
+		}
+
+		layer_render(&test, mvp);
 
 		SDL_GL_SwapWindow(window);
+
+		pager_collect();
 	}
 
+	light_wait();
 	layer_destroy(&test);
+	pager_destroy();
+	render_destroy();
+	thread_pool_destroy();
 
 	SDL_GL_DeleteContext(ctx);
 	SDL_DestroyWindow(window);
@@ -0,0 +1,540 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pager.h"
+#include "raycast.h"
+#include "thread_pool.h"
+
+#define RAYCAST_TILE 32
+// dense grids may hold this many cells per chunk of the layer
+#define RAYCAST_DENSE_RATIO 64
+#define RAYCAST_DENSE_MIN 65536
+
+/*
+	Chunk lookup over the bounds of a layer, only chunks in view with solid
+	blocks are found. Dense grids hold a cell per chunk. Layers spread far
+	apart look up the layer table instead and mark which blocks of 2^level
+	chunks hold any chunk in view, so empty space is stepped over in large
+	blocks.
+*/
+struct raycast_grid {
+	int min[3];
+	int size[3];
+	struct layer_chunk** cells;
+	// sparse only, both are read only on the workers
+	HashTable* chunks;
+	// levels[k] marks blocks of 2^(k + 1) chunks
+	HashTable* levels;
+	int level_count;
+};
+
+struct raycast_context {
+	struct raycast_grid* grids;
+	size_t count;
+	struct raycast_image* img;
+	int tiles_x;
+	vec3 origin;
+	vec3 forward;
+	// scaled to reach the image border
+	vec3 right, up;
+	// inward normals of the four sides of the view through the origin
+	vec3 planes[4];
+};
+
+struct raycast_grid_context {
+	struct raycast_grid* grid;
+	struct raycast_context* view;
+};
+
+struct raycast_hit {
+	float t;
+	int axis;
+	int step;
+	struct color color;
+};
+
+static int raycast_clamp(int v, int length) {
+	return v < 0 ? 0 : (v < length ? v : length - 1);
+}
+
+static size_t raycast_index(struct raycast_grid* g, int* cell) {
+	return cell[0] + (cell[1] + (size_t)cell[2] * g->size[1]) * g->size[0];
+}
+
+void raycast_image_create(struct raycast_image* img, int width, int height) {
+	assert(img && width > 0 && height > 0);
+
+	img->width = width;
+	img->height = height;
+	img->pixels = malloc(width * height * 3);
+	assert(img->pixels);
+}
+
+void raycast_image_destroy(struct raycast_image* img) {
+	assert(img);
+	free(img->pixels);
+}
+
+bool raycast_image_write(struct raycast_image* img, const char* path) {
+	assert(img && path);
+
+	FILE* f = fopen(path, "wb");
+
+	if(!f)
+		return false;
+
+	fprintf(f, "P6\n%d %d\n255\n", img->width, img->height);
+	size_t length = (size_t)img->width * img->height * 3;
+	bool success = fwrite(img->pixels, 1, length, f) == length;
+
+	return fclose(f) == 0 && success;
+}
+
+/*
+	Rays start at the origin and stay within the sides of the view, chunks
+	entirely outside of them are never reached. There is no far plane.
+*/
+static bool raycast_visible(struct raycast_context* ctx,
+							struct layer_chunk* c) {
+	vec3 center = {(c->x + 0.5F) * LAYER_CHUNK_SIZE,
+				   (c->y + 0.5F) * LAYER_CHUNK_SIZE,
+				   (c->z + 0.5F) * LAYER_CHUNK_SIZE};
+	glm_vec3_sub(center, ctx->origin, center);
+
+	for(int k = 0; k < 4; k++) {
+		if(glm_vec3_dot(center, ctx->planes[k]) < -LAYER_CHUNK_RADIUS)
+			return false;
+	}
+
+	return true;
+}
+
+static bool raycast_grid_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+	struct raycast_grid_context* ctx = (struct raycast_grid_context*)user;
+	struct raycast_grid* g = ctx->grid;
+
+	if(!c->solid_blocks || !raycast_visible(ctx->view, c))
+		return true;
+
+	// workers only read blocks, nothing is paged out before pager_collect()
+	pager_touch(c);
+
+	int cell[3] = {c->x - g->min[0], c->y - g->min[1], c->z - g->min[2]};
+
+	if(g->cells)
+		g->cells[raycast_index(g, cell)] = c;
+
+	for(int k = 0; k < g->level_count; k++) {
+		ht_insert(g->levels + k,
+				  (int[3]) {cell[0] >> (k + 1), cell[1] >> (k + 1),
+							cell[2] >> (k + 1)},
+				  &(bool) {true});
+	}
+
+	return true;
+}
+
+static void raycast_grid_create(struct raycast_grid* g, struct layer* l,
+								struct raycast_context* view) {
+	struct layer_stats stats;
+	layer_stats(l, &stats);
+
+	g->cells = NULL;
+	g->chunks = NULL;
+	g->levels = NULL;
+	g->level_count = 0;
+
+	if(!stats.solid_voxels) {
+		g->size[0] = g->size[1] = g->size[2] = 0;
+		return;
+	}
+
+	int largest = 0;
+
+	for(int k = 0; k < 3; k++) {
+		g->min[k] = LAYER_CHUNK_COORD(stats.min[k]);
+		g->size[k] = LAYER_CHUNK_COORD(stats.max[k]) - g->min[k] + 1;
+		largest = g->size[k] > largest ? g->size[k] : largest;
+	}
+
+	double volume = (double)g->size[0] * g->size[1] * g->size[2];
+
+	if(volume <= (double)l->chunks.size * RAYCAST_DENSE_RATIO
+			+ RAYCAST_DENSE_MIN) {
+		g->cells = calloc((size_t)volume, sizeof(struct layer_chunk*));
+		assert(g->cells);
+	} else {
+		g->chunks = &l->chunks;
+
+		// up to a single block over the whole grid
+		while((largest - 1) >> g->level_count)
+			g->level_count++;
+
+		g->levels = malloc(g->level_count * sizeof(HashTable));
+		assert(g->levels);
+
+		for(int k = 0; k < g->level_count; k++)
+			layer_chunk_table(g->levels + k, sizeof(bool));
+	}
+
+	ht_iterate(&l->chunks,
+			   &(struct raycast_grid_context) {.grid = g, .view = view},
+			   raycast_grid_callback);
+}
+
+static void raycast_grid_destroy(struct raycast_grid* g) {
+	free(g->cells);
+
+	for(int k = 0; k < g->level_count; k++)
+		ht_destroy(g->levels + k);
+
+	free(g->levels);
+}
+
+static struct layer_chunk* raycast_lookup(struct raycast_grid* g,
+										  int* cell) {
+	if(g->cells)
+		return g->cells[raycast_index(g, cell)];
+
+	struct layer_chunk* c = ht_lookup(
+		g->chunks,
+		(int[3]) {g->min[0] + cell[0], g->min[1] + cell[1],
+				  g->min[2] + cell[2]});
+
+	// chunks in view were paged in, rays don't reach the others
+	return c && c->solid_blocks && layer_chunk_resident(c) ? c : NULL;
+}
+
+// highest level whose block around an empty cell holds no chunk in view
+static int raycast_empty_level(struct raycast_grid* g, int* cell) {
+	int level = 0;
+
+	while(level < g->level_count
+		  && !ht_lookup(g->levels + level,
+						(int[3]) {cell[0] >> (level + 1),
+								  cell[1] >> (level + 1),
+								  cell[2] >> (level + 1)}))
+		level++;
+
+	return level;
+}
+
+// distance at which the ray leaves a cell of the grid along axis k
+static float raycast_boundary(struct raycast_grid* g, vec3 origin, vec3 dir,
+							  vec3 inv, int* cell, int k) {
+	if(dir[k] == 0.0F)
+		return INFINITY;
+
+	int boundary = g->min[k] + cell[k] + (dir[k] > 0.0F);
+	return ((float)boundary * LAYER_CHUNK_SIZE - origin[k]) * inv[k];
+}
+
+// steps through the voxels of one chunk from distance t up to t_exit
+static bool raycast_chunk(struct layer_chunk* c, vec3 origin, vec3 dir,
+						  vec3 inv, float t, float t_exit, int axis,
+						  struct raycast_hit* hit) {
+	int base[3] = {c->x * LAYER_CHUNK_SIZE, c->y * LAYER_CHUNK_SIZE,
+				   c->z * LAYER_CHUNK_SIZE};
+	int voxel[3], step[3];
+	float next[3], delta[3];
+
+	for(int k = 0; k < 3; k++) {
+		int v = (int)floorf(origin[k] + dir[k] * t) - base[k];
+		voxel[k] = raycast_clamp(v, LAYER_CHUNK_SIZE);
+		step[k] = (dir[k] > 0.0F) - (dir[k] < 0.0F);
+
+		if(step[k]) {
+			next[k] = (base[k] + voxel[k] + (step[k] > 0) - origin[k]) * inv[k];
+			delta[k] = fabsf(inv[k]);
+		} else {
+			next[k] = INFINITY;
+			delta[k] = INFINITY;
+		}
+	}
+
+	struct layer_chunk_block* blocks = c->payload->blocks;
+
+	while(1) {
+		struct layer_chunk_block* b
+			= blocks + LAYER_CHUNK_INDEX(voxel[0], voxel[1], voxel[2]);
+
+		if(b->solid) {
+			*hit = (struct raycast_hit) {
+				.t = t,
+				.axis = axis,
+				.step = step[axis],
+				.color = b->color,
+			};
+
+			return true;
+		}
+
+		int k = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) :
+									(next[1] < next[2] ? 1 : 2);
+
+		if(next[k] >= t_exit)
+			return false;
+
+		voxel[k] += step[k];
+
+		if(voxel[k] < 0 || voxel[k] >= LAYER_CHUNK_SIZE)
+			return false;
+
+		t = next[k];
+		next[k] += delta[k];
+		axis = k;
+	}
+}
+
+/*
+	Two level traversal, chunk cells of the grid first and voxels only
+	within chunks that hold any solid block. Hits beyond t_max are ignored.
+*/
+static bool raycast_trace(struct raycast_grid* g, vec3 origin, vec3 dir,
+						  float t_max, struct raycast_hit* hit) {
+	if(!g->cells && !g->chunks)
+		return false;
+
+	vec3 inv;
+	float t = 0.0F;
+	int axis = 0;
+
+	// clip against the bounds of the grid
+	for(int k = 0; k < 3; k++) {
+		float lo = (float)g->min[k] * LAYER_CHUNK_SIZE;
+		float hi = ((float)g->min[k] + g->size[k]) * LAYER_CHUNK_SIZE;
+
+		if(dir[k] == 0.0F) {
+			if(origin[k] < lo || origin[k] >= hi)
+				return false;
+
+			inv[k] = INFINITY;
+			continue;
+		}
+
+		inv[k] = 1.0F / dir[k];
+
+		float a = (lo - origin[k]) * inv[k];
+		float b = (hi - origin[k]) * inv[k];
+
+		if(a > b) {
+			float tmp = a;
+			a = b;
+			b = tmp;
+		}
+
+		if(a > t) {
+			t = a;
+			axis = k;
+		}
+
+		t_max = fminf(t_max, b);
+	}
+
+	if(t >= t_max)
+		return false;
+
+	int cell[3], step[3];
+	float next[3], delta[3];
+
+	for(int k = 0; k < 3; k++) {
+		int v = (int)floorf((origin[k] + dir[k] * t) / LAYER_CHUNK_SIZE)
+			- g->min[k];
+		cell[k] = raycast_clamp(v, g->size[k]);
+		step[k] = (dir[k] > 0.0F) - (dir[k] < 0.0F);
+		next[k] = raycast_boundary(g, origin, dir, inv, cell, k);
+		delta[k] = step[k] ? LAYER_CHUNK_SIZE * fabsf(inv[k]) : INFINITY;
+	}
+
+	while(1) {
+		struct layer_chunk* c = raycast_lookup(g, cell);
+		int level
+			= !c && g->level_count ? raycast_empty_level(g, cell) : 0;
+
+		if(level > 0) {
+			// leave the whole empty block, ends on the nearest of its sides
+			int k = 0;
+			int edge[3];
+			float t_block = INFINITY;
+
+			for(int j = 0; j < 3; j++) {
+				if(!step[j])
+					continue;
+
+				edge[j] = ((cell[j] >> level) + (step[j] > 0)) << level;
+				float b = ((float)g->min[j] + edge[j]) * LAYER_CHUNK_SIZE;
+				float t_edge = (b - origin[j]) * inv[j];
+
+				if(t_edge < t_block) {
+					t_block = t_edge;
+					k = j;
+				}
+			}
+
+			if(t_block >= t_max)
+				return false;
+
+			t = fmaxf(t, t_block);
+
+			for(int j = 0; j < 3; j++) {
+				int v;
+
+				if(j == k) {
+					// exactly on the side, rounding could pick either cell
+					v = edge[k] - (step[k] < 0);
+				} else {
+					v = (int)floorf((origin[j] + dir[j] * t) / LAYER_CHUNK_SIZE)
+						- g->min[j];
+					// never step back, so the traversal always ends
+					v = step[j] > 0 ? (v > cell[j] ? v : cell[j]) :
+									  (v < cell[j] ? v : cell[j]);
+				}
+
+				if(v < 0 || v >= g->size[j])
+					return false;
+
+				cell[j] = v;
+				next[j] = raycast_boundary(g, origin, dir, inv, cell, j);
+			}
+
+			axis = k;
+			continue;
+		}
+
+		int k = next[0] < next[1] ? (next[0] < next[2] ? 0 : 2) :
+									(next[1] < next[2] ? 1 : 2);
+		float t_exit = fminf(next[k], t_max);
+
+		if(c && raycast_chunk(c, origin, dir, inv, t, t_exit, axis, hit))
+			return true;
+
+		if(next[k] >= t_max)
+			return false;
+
+		cell[k] += step[k];
+
+		if(cell[k] < 0 || cell[k] >= g->size[k])
+			return false;
+
+		t = next[k];
+		next[k] += delta[k];
+		axis = k;
+	}
+}
+
+static void raycast_tile(size_t job, void* user) {
+	struct raycast_context* ctx = (struct raycast_context*)user;
+	struct raycast_image* img = ctx->img;
+
+	int x0 = (job % ctx->tiles_x) * RAYCAST_TILE;
+	int y0 = (job / ctx->tiles_x) * RAYCAST_TILE;
+	int x1 = x0 + RAYCAST_TILE < img->width ? x0 + RAYCAST_TILE : img->width;
+	int y1 = y0 + RAYCAST_TILE < img->height ? y0 + RAYCAST_TILE : img->height;
+
+	// same light direction as the vertex shader in render.c
+	vec3 light = {0.36F, 0.48F, 0.8F};
+
+	for(int y = y0; y < y1; y++) {
+		float v = 1.0F - (2.0F * y + 1.0F) / img->height;
+
+		for(int x = x0; x < x1; x++) {
+			float u = (2.0F * x + 1.0F) / img->width - 1.0F;
+			vec3 dir;
+
+			for(int k = 0; k < 3; k++)
+				dir[k] = ctx->forward[k] + ctx->right[k] * u + ctx->up[k] * v;
+
+			struct raycast_hit hit = {.t = INFINITY};
+
+			for(size_t l = 0; l < ctx->count; l++)
+				raycast_trace(ctx->grids + l, ctx->origin, dir, hit.t, &hit);
+
+			uint8_t* out = img->pixels + (y * img->width + x) * 3;
+
+			if(isinf(hit.t)) {
+				out[0] = out[1] = out[2] = 0;
+				continue;
+			}
+
+			// the face looks against the direction of the ray
+			float shade = 0.7F - 0.3F * light[hit.axis] * hit.step;
+			out[0] = (uint8_t)(hit.color.red * shade);
+			out[1] = (uint8_t)(hit.color.green * shade);
+			out[2] = (uint8_t)(hit.color.blue * shade);
+		}
+	}
+}
+
+void raycast_render(struct layer* layers, size_t count, struct camera* camera,
+					struct raycast_image* img) {
+	assert((layers || !count) && camera && img);
+
+	struct raycast_context ctx = {
+		.count = count,
+		.img = img,
+		.tiles_x = (img->width + RAYCAST_TILE - 1) / RAYCAST_TILE,
+	};
+
+	// same view as camera_matrix()
+	camera_position(camera, ctx.origin);
+	glm_vec3_sub(camera->target, ctx.origin, ctx.forward);
+	glm_vec3_normalize(ctx.forward);
+	glm_vec3_cross(ctx.forward, (vec3) {0.0F, 0.0F, 1.0F}, ctx.right);
+	glm_vec3_normalize(ctx.right);
+	glm_vec3_cross(ctx.right, ctx.forward, ctx.up);
+
+	float half = tanf(camera->fov / 2.0F);
+	glm_vec3_scale(ctx.right, half * img->width / img->height, ctx.right);
+	glm_vec3_scale(ctx.up, half, ctx.up);
+
+	for(int k = 0; k < 4; k++) {
+		// spanned by the ray through the middle of a border and that border
+		float* border = k < 2 ? ctx.right : ctx.up;
+		float* along = k < 2 ? ctx.up : ctx.right;
+		vec3 edge;
+		glm_vec3_scale(border, (k & 1) ? -1.0F : 1.0F, edge);
+		glm_vec3_add(ctx.forward, edge, edge);
+		glm_vec3_cross(edge, along, ctx.planes[k]);
+		glm_vec3_normalize(ctx.planes[k]);
+
+		if(glm_vec3_dot(ctx.planes[k], ctx.forward) < 0.0F)
+			glm_vec3_scale(ctx.planes[k], -1.0F, ctx.planes[k]);
+	}
+
+	ctx.grids = malloc(count * sizeof(struct raycast_grid));
+	assert(ctx.grids || !count);
+
+	for(size_t k = 0; k < count; k++)
+		raycast_grid_create(ctx.grids + k, layers + k, &ctx);
+
+	int tiles_y = (img->height + RAYCAST_TILE - 1) / RAYCAST_TILE;
+	thread_pool_run(ctx.tiles_x * tiles_y, raycast_tile, &ctx);
+
+	for(size_t k = 0; k < count; k++)
+		raycast_grid_destroy(ctx.grids + k);
+
+	free(ctx.grids);
+}
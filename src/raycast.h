@@ -0,0 +1,51 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PINKED_RAYCAST_H
+#define PINKED_RAYCAST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "camera.h"
+#include "layer.h"
+
+struct raycast_image {
+	int width, height;
+	// RGB, rows from top to bottom
+	uint8_t* pixels;
+};
+
+void raycast_image_create(struct raycast_image* img, int width, int height);
+void raycast_image_destroy(struct raycast_image* img);
+// binary PPM
+bool raycast_image_write(struct raycast_image* img, const char* path);
+
+/*
+	Renders layers on the CPU without a GL context by casting one ray per
+	pixel through their chunks. Missing and empty chunks are stepped over as
+	a whole, tiles of the image are traced on the thread pool. Faces are
+	shaded like in render.c, but without the baked light of light.h.
+*/
+void raycast_render(struct layer* layers, size_t count, struct camera* camera,
+					struct raycast_image* img);
+
+#endif
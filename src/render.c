@@ -0,0 +1,249 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render.h"
+
+static const char* vertex_source
+	= "#version 100\n"
+	  "uniform mat4 mvp;\n"
+	  "uniform vec3 offset;\n"
+	  "attribute vec4 v_position;\n"
+	  "attribute float v_color;\n"
+	  "attribute float v_light;\n"
+	  "varying vec3 f_color;\n"
+	  "void main() {\n"
+	  "	float axis = floor(v_position.w / 2.0);\n"
+	  "	float dir = mod(v_position.w, 2.0) * 2.0 - 1.0;\n"
+	  "	vec3 normal = vec3(equal(vec3(axis), vec3(0.0, 1.0, 2.0))) * dir;\n"
+	  "	float shade = 0.7 + 0.3 * dot(normal, vec3(0.36, 0.48, 0.8));\n"
+	  "	vec3 rgb = vec3(floor(v_color / 2048.0),\n"
+	  "					mod(floor(v_color / 32.0), 64.0),\n"
+	  "					mod(v_color, 32.0));\n"
+	  "	f_color = rgb / vec3(31.0, 63.0, 31.0) * shade * v_light;\n"
+	  "	gl_Position = mvp * vec4(v_position.xyz + offset, 1.0);\n"
+	  "}";
+
+static const char* fragment_source = "#version 100\n"
+									 "precision mediump float;\n"
+									 "varying vec3 f_color;\n"
+									 "void main() {\n"
+									 "	gl_FragColor = vec4(f_color, 1.0);\n"
+									 "}";
+
+// adds one to every channel per fragment that passes the depth test
+static const char* overdraw_source = "#version 100\n"
+									 "precision mediump float;\n"
+									 "varying vec3 f_color;\n"
+									 "void main() {\n"
+									 "	gl_FragColor = vec4(1.0 / 255.0);\n"
+									 "}";
+
+const int render_face_normals[6][3] = {
+	[FACE_LEFT] = {-1, 0, 0},  [FACE_RIGHT] = {1, 0, 0},
+	[FACE_FRONT] = {0, -1, 0}, [FACE_BACK] = {0, 1, 0},
+	[FACE_BOTTOM] = {0, 0, -1}, [FACE_TOP] = {0, 0, 1},
+};
+
+const uint8_t render_face_corners[2][4][2] = {
+	{{0, 0}, {1, 0}, {1, 1}, {0, 1}},
+	{{0, 0}, {0, 1}, {1, 1}, {1, 0}},
+};
+
+struct render_shader {
+	GLuint program;
+	GLint mvp;
+	GLint offset;
+};
+
+static struct {
+	struct render_shader shaded;
+	struct render_shader overdraw;
+	struct render_shader* current;
+	GLuint indices;
+	struct render_stats stats;
+} render;
+
+static bool render_compile(GLuint shader, const char* source) {
+	glShaderSource(shader, 1, &source, (GLint[]) {strlen(source)});
+	glCompileShader(shader);
+
+	GLint status;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+	if(status != GL_TRUE) {
+		char log[512];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("shader compilation failed: %s\n", log);
+	}
+
+	return status == GL_TRUE;
+}
+
+static bool render_link(struct render_shader* shader, GLuint shader_v,
+						GLuint shader_f) {
+	shader->program = glCreateProgram();
+	glAttachShader(shader->program, shader_v);
+	glAttachShader(shader->program, shader_f);
+	glBindAttribLocation(shader->program, 0, "v_position");
+	glBindAttribLocation(shader->program, 1, "v_color");
+	glBindAttribLocation(shader->program, 2, "v_light");
+	glLinkProgram(shader->program);
+
+	GLint status;
+	glGetProgramiv(shader->program, GL_LINK_STATUS, &status);
+
+	shader->mvp = glGetUniformLocation(shader->program, "mvp");
+	shader->offset = glGetUniformLocation(shader->program, "offset");
+
+	return status == GL_TRUE;
+}
+
+bool render_init(void) {
+	GLuint shader_v = glCreateShader(GL_VERTEX_SHADER);
+	GLuint shader_f = glCreateShader(GL_FRAGMENT_SHADER);
+	GLuint shader_o = glCreateShader(GL_FRAGMENT_SHADER);
+
+	if(!render_compile(shader_v, vertex_source)
+	   || !render_compile(shader_f, fragment_source)
+	   || !render_compile(shader_o, overdraw_source))
+		return false;
+
+	bool linked = render_link(&render.shaded, shader_v, shader_f)
+		&& render_link(&render.overdraw, shader_v, shader_o);
+
+	glDeleteShader(shader_v);
+	glDeleteShader(shader_f);
+	glDeleteShader(shader_o);
+
+	if(!linked)
+		return false;
+
+	render.stats = (struct render_stats) {0};
+	render.current = &render.shaded;
+
+	uint16_t* indices = malloc(RENDER_MAX_QUADS * 6 * sizeof(uint16_t));
+	assert(indices);
+
+	for(size_t k = 0; k < RENDER_MAX_QUADS; k++) {
+		indices[k * 6 + 0] = k * 4 + 0;
+		indices[k * 6 + 1] = k * 4 + 1;
+		indices[k * 6 + 2] = k * 4 + 2;
+		indices[k * 6 + 3] = k * 4 + 0;
+		indices[k * 6 + 4] = k * 4 + 2;
+		indices[k * 6 + 5] = k * 4 + 3;
+	}
+
+	glGenBuffers(1, &render.indices);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.indices);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+				 RENDER_MAX_QUADS * 6 * sizeof(uint16_t), indices,
+				 GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	free(indices);
+
+	return true;
+}
+
+void render_destroy(void) {
+	glDeleteBuffers(1, &render.indices);
+	glDeleteProgram(render.overdraw.program);
+	glDeleteProgram(render.shaded.program);
+}
+
+GLuint render_program(void) {
+	return render.shaded.program;
+}
+
+void render_set_overdraw(bool enable) {
+	render.current = enable ? &render.overdraw : &render.shaded;
+	glUseProgram(render.current->program);
+
+	if(enable) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+	} else {
+		glDisable(GL_BLEND);
+	}
+}
+
+void render_set_mvp(mat4 mvp) {
+	glUniformMatrix4fv(render.current->mvp, 1, GL_FALSE, (float*)mvp);
+}
+
+uint16_t render_pack_color(struct color c) {
+	return ((c.red >> 3) << 11) | ((c.green >> 2) << 5) | (c.blue >> 3);
+}
+
+void render_upload(GLuint vbo, struct render_vertex* vertices, size_t count) {
+	assert(vertices || !count);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, count * sizeof(struct render_vertex),
+				 vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	render.stats.uploads++;
+	render.stats.uploaded_bytes += count * sizeof(struct render_vertex);
+}
+
+void render_draw_quads(GLuint vbo, size_t quads, int x, int y, int z) {
+	assert(quads <= RENDER_MAX_QUADS);
+
+	if(!quads)
+		return;
+
+	render.stats.draw_calls++;
+	render.stats.quads += quads;
+
+	glUniform3f(render.current->offset, x, y, z);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, render.indices);
+
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 4, GL_UNSIGNED_BYTE, GL_FALSE,
+						  sizeof(struct render_vertex),
+						  (void*)offsetof(struct render_vertex, x));
+	glVertexAttribPointer(1, 1, GL_UNSIGNED_SHORT, GL_FALSE,
+						  sizeof(struct render_vertex),
+						  (void*)offsetof(struct render_vertex, color));
+	glVertexAttribPointer(2, 1, GL_UNSIGNED_BYTE, GL_TRUE,
+						  sizeof(struct render_vertex),
+						  (void*)offsetof(struct render_vertex, light));
+	glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_SHORT, NULL);
+	glDisableVertexAttribArray(2);
+	glDisableVertexAttribArray(1);
+	glDisableVertexAttribArray(0);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void render_stats(struct render_stats* stats) {
+	assert(stats);
+	*stats = render.stats;
+}
@@ -0,0 +1,85 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_RENDER_H
+#define PINKED_RENDER_H
+
+#include <GLES2/gl2.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <cglm/cglm.h>
+
+#include "color.h"
+
+enum render_face {
+	FACE_LEFT = 0,	 // -x
+	FACE_RIGHT = 1,	 // +x
+	FACE_FRONT = 2,	 // -y
+	FACE_BACK = 3,	 // +y
+	FACE_BOTTOM = 4, // -z
+	FACE_TOP = 5,	 // +z
+};
+
+// 4 of these form one quad, indexed by a shared static index buffer
+struct render_vertex {
+	uint8_t x, y, z;
+	uint8_t face;
+	// RGB565
+	uint16_t color;
+	// brightness from ambient occlusion and sunlight, 255 is fully lit
+	uint8_t light;
+	uint8_t reserved;
+};
+
+extern const int render_face_normals[6][3];
+// clockwise when looking at the face from outside, see glFrontFace()
+extern const uint8_t render_face_corners[2][4][2];
+
+// 16 bit indices address at most 65536 vertices per draw call
+#define RENDER_MAX_QUADS 16384
+
+// counted since render_init()
+struct render_stats {
+	size_t draw_calls;
+	size_t quads;
+	size_t uploads;
+	size_t uploaded_bytes;
+};
+
+bool render_init(void);
+void render_destroy(void);
+
+GLuint render_program(void);
+/*
+	Debug mode that makes every fragment passing the depth test add 1 to the
+	color channels of an 8 bit target instead of shading it. Switches the
+	program in use, the mvp has to be set again afterwards.
+*/
+void render_set_overdraw(bool enable);
+void render_set_mvp(mat4 mvp);
+uint16_t render_pack_color(struct color c);
+
+void render_upload(GLuint vbo, struct render_vertex* vertices, size_t count);
+// positions are relative to the given offset in world units
+void render_draw_quads(GLuint vbo, size_t quads, int x, int y, int z);
+void render_stats(struct render_stats* stats);
+
+#endif
@@ -0,0 +1,727 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "edit_batch.h"
+#include "pager.h"
+#include "selection.h"
+
+// a word holds four rows along x of increasing z, one 16 bit lane each
+#define SELECTION_LANE_LOW 0x0001000100010001ULL
+#define SELECTION_LANE_HIGH 0x8000800080008000ULL
+
+#define SELECTION_KEY(x, y, z)                                                 \
+	(int[3]) {                                                                 \
+		LAYER_CHUNK_COORD(x), LAYER_CHUNK_COORD(y), LAYER_CHUNK_COORD(z)       \
+	}
+
+struct selection_keys {
+	int (*keys)[3];
+	size_t length;
+	size_t capacity;
+};
+
+struct selection_match {
+	struct selection* s;
+	bool any_color;
+	struct color color;
+	int tolerance;
+};
+
+struct selection_morph {
+	struct selection* src;
+	HashTable* dst;
+	bool grow;
+};
+
+struct selection_offset {
+	int offset[3];
+	HashTable* dst;
+};
+
+struct selection_voxels {
+	struct layer* l;
+	struct edit_batch* batch;
+	int offset[3];
+	struct color color;
+};
+
+static const struct selection_chunk selection_none = {{0}};
+
+static size_t selection_popcount(uint64_t x) {
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+}
+
+// index of the lowest set bit, x must not be zero
+static size_t selection_lowest_bit(uint64_t x) {
+	static const uint8_t debruijn[64] = {
+		0,	1,	48, 2,	57, 49, 28, 3,	61, 58, 50, 42, 38, 29, 17, 4,
+		62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+		63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+		46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9,	13, 8,	7,	6,
+	};
+
+	return debruijn[((x & -x) * 0x03F79D71B4CB0A89ULL) >> 58];
+}
+
+static bool selection_chunk_empty(struct selection_chunk* c) {
+	for(size_t k = 0; k < SELECTION_WORDS; k++) {
+		if(c->bits[k])
+			return false;
+	}
+
+	return true;
+}
+
+static struct selection_chunk* selection_chunk(struct selection* s, int x,
+											   int y, int z, bool create) {
+	struct selection_chunk* c = ht_lookup(&s->chunks, (int[3]) {x, y, z});
+
+	if(!c && create) {
+		ht_insert(&s->chunks, (int[3]) {x, y, z}, (void*)&selection_none);
+		c = ht_lookup(&s->chunks, (int[3]) {x, y, z});
+	}
+
+	return c;
+}
+
+static bool selection_empty_callback(void* key, void* value, void* user) {
+	struct selection_keys* list = (struct selection_keys*)user;
+
+	if(!selection_chunk_empty((struct selection_chunk*)value))
+		return true;
+
+	if(list->length == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 16;
+		list->keys = realloc(list->keys, list->capacity * sizeof(int[3]));
+		assert(list->keys);
+	}
+
+	memcpy(list->keys[list->length++], key, sizeof(int[3]));
+	return true;
+}
+
+// removes chunks that became empty, the table can't change while iterating
+static void selection_prune(struct selection* s) {
+	struct selection_keys list = {.keys = NULL, .length = 0, .capacity = 0};
+	ht_iterate(&s->chunks, &list, selection_empty_callback);
+
+	for(size_t k = 0; k < list.length; k++)
+		ht_erase(&s->chunks, list.keys[k]);
+
+	free(list.keys);
+}
+
+void selection_create(struct selection* s) {
+	assert(s);
+	layer_chunk_table(&s->chunks, sizeof(struct selection_chunk));
+}
+
+static bool selection_copy_callback(void* key, void* value, void* user) {
+	ht_insert((HashTable*)user, key, value);
+	return true;
+}
+
+void selection_copy(struct selection* dst, struct selection* src) {
+	assert(dst && src);
+
+	selection_create(dst);
+	ht_iterate(&src->chunks, &dst->chunks, selection_copy_callback);
+}
+
+void selection_destroy(struct selection* s) {
+	assert(s);
+	ht_destroy(&s->chunks);
+}
+
+void selection_clear(struct selection* s) {
+	assert(s);
+	ht_clear(&s->chunks);
+}
+
+static bool selection_count_callback(void* key, void* value, void* user) {
+	struct selection_chunk* c = (struct selection_chunk*)value;
+
+	for(size_t k = 0; k < SELECTION_WORDS; k++)
+		*(size_t*)user += selection_popcount(c->bits[k]);
+
+	return true;
+}
+
+size_t selection_count(struct selection* s) {
+	assert(s);
+
+	size_t count = 0;
+	ht_iterate(&s->chunks, &count, selection_count_callback);
+	return count;
+}
+
+bool selection_contains(struct selection* s, int x, int y, int z) {
+	assert(s);
+
+	struct selection_chunk* c = ht_lookup(&s->chunks, SELECTION_KEY(x, y, z));
+
+	if(!c)
+		return false;
+
+	size_t index = LAYER_CHUNK_INDEX(LAYER_LOCAL_COORD(x), LAYER_LOCAL_COORD(y),
+									 LAYER_LOCAL_COORD(z));
+	return (c->bits[index / 64] >> (index % 64)) & 1;
+}
+
+void selection_set(struct selection* s, int x, int y, int z, bool selected) {
+	assert(s);
+
+	struct selection_chunk* c
+		= selection_chunk(s, LAYER_CHUNK_COORD(x), LAYER_CHUNK_COORD(y),
+						  LAYER_CHUNK_COORD(z), selected);
+
+	if(!c)
+		return;
+
+	size_t index = LAYER_CHUNK_INDEX(LAYER_LOCAL_COORD(x), LAYER_LOCAL_COORD(y),
+									 LAYER_LOCAL_COORD(z));
+
+	if(selected) {
+		c->bits[index / 64] |= 1ULL << (index % 64);
+	} else {
+		c->bits[index / 64] &= ~(1ULL << (index % 64));
+
+		if(selection_chunk_empty(c))
+			ht_erase(&s->chunks, SELECTION_KEY(x, y, z));
+	}
+}
+
+// part of the box inside of chunk x, y, z
+static void selection_box_mask(int* min, int* max, int x, int y, int z,
+							   struct selection_chunk* out) {
+	int lo[3], hi[3];
+	int chunk[3] = {x, y, z};
+
+	for(int k = 0; k < 3; k++) {
+		int base = chunk[k] * LAYER_CHUNK_SIZE;
+		lo[k] = (min[k] > base) ? min[k] - base : 0;
+		hi[k] = (max[k] < base + LAYER_CHUNK_SIZE - 1) ? max[k] - base :
+														 LAYER_CHUNK_SIZE - 1;
+	}
+
+	memset(out->bits, 0, sizeof(out->bits));
+
+	uint64_t row = (0xFFFFULL >> (15 - (hi[0] - lo[0]))) << lo[0];
+
+	for(int lz = lo[2]; lz <= hi[2]; lz++) {
+		for(int ly = lo[1]; ly <= hi[1]; ly++) {
+			size_t index = LAYER_CHUNK_INDEX(0, ly, lz);
+			out->bits[index / 64] |= row << (index % 64);
+		}
+	}
+}
+
+static void selection_apply_box(struct selection* s, int* min, int* max,
+								bool invert) {
+	int lo[3], hi[3];
+
+	for(int k = 0; k < 3; k++) {
+		lo[k] = LAYER_CHUNK_COORD(min[k]);
+		hi[k] = LAYER_CHUNK_COORD(max[k]);
+	}
+
+	for(int z = lo[2]; z <= hi[2]; z++) {
+		for(int y = lo[1]; y <= hi[1]; y++) {
+			for(int x = lo[0]; x <= hi[0]; x++) {
+				struct selection_chunk mask;
+				selection_box_mask(min, max, x, y, z, &mask);
+
+				struct selection_chunk* c = selection_chunk(s, x, y, z, true);
+
+				for(size_t k = 0; k < SELECTION_WORDS; k++)
+					c->bits[k] = invert ? c->bits[k] ^ mask.bits[k] :
+										  c->bits[k] | mask.bits[k];
+			}
+		}
+	}
+}
+
+void selection_add_box(struct selection* s, int* min, int* max) {
+	assert(s && min && max);
+	assert(min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2]);
+
+	selection_apply_box(s, min, max, false);
+}
+
+static bool selection_match_callback(void* key, void* value, void* user) {
+	struct layer_chunk* c = (struct layer_chunk*)value;
+	struct selection_match* m = (struct selection_match*)user;
+	struct selection_chunk mask = selection_none;
+	bool any = false;
+
+	pager_touch(c);
+
+	for(size_t k = 0; k < LAYER_CHUNK_VOLUME; k++) {
+		struct layer_chunk_block* b = c->payload->blocks + k;
+
+		if(b->solid
+		   && (m->any_color
+			   || (abs(b->color.red - m->color.red) <= m->tolerance
+				   && abs(b->color.green - m->color.green) <= m->tolerance
+				   && abs(b->color.blue - m->color.blue) <= m->tolerance))) {
+			mask.bits[k / 64] |= 1ULL << (k % 64);
+			any = true;
+		}
+	}
+
+	if(any) {
+		struct selection_chunk* dst
+			= selection_chunk(m->s, c->x, c->y, c->z, true);
+
+		for(size_t k = 0; k < SELECTION_WORDS; k++)
+			dst->bits[k] |= mask.bits[k];
+	}
+
+	return true;
+}
+
+void selection_add_solid(struct selection* s, struct layer* l) {
+	assert(s && l);
+
+	struct selection_match m = {.s = s, .any_color = true};
+	ht_iterate(&l->chunks, &m, selection_match_callback);
+}
+
+void selection_add_color(struct selection* s, struct layer* l,
+						 struct color color, int tolerance) {
+	assert(s && l && tolerance >= 0);
+
+	struct selection_match m = {
+		.s = s,
+		.any_color = false,
+		.color = color,
+		.tolerance = tolerance,
+	};
+
+	ht_iterate(&l->chunks, &m, selection_match_callback);
+}
+
+static bool selection_union_callback(void* key, void* value, void* user) {
+	int* pos = (int*)key;
+	struct selection_chunk* src = (struct selection_chunk*)value;
+	struct selection_chunk* dst = selection_chunk(
+		(struct selection*)user, pos[0], pos[1], pos[2], true);
+
+	for(size_t k = 0; k < SELECTION_WORDS; k++)
+		dst->bits[k] |= src->bits[k];
+
+	return true;
+}
+
+void selection_union(struct selection* dst, struct selection* src) {
+	assert(dst && src && dst != src);
+	ht_iterate(&src->chunks, dst, selection_union_callback);
+}
+
+static bool selection_intersect_callback(void* key, void* value, void* user) {
+	struct selection_chunk* dst = (struct selection_chunk*)value;
+	struct selection_chunk* src = ht_lookup(&((struct selection*)user)->chunks,
+											key);
+
+	for(size_t k = 0; k < SELECTION_WORDS; k++)
+		dst->bits[k] &= src ? src->bits[k] : 0;
+
+	return true;
+}
+
+void selection_intersect(struct selection* dst, struct selection* src) {
+	assert(dst && src && dst != src);
+
+	ht_iterate(&dst->chunks, src, selection_intersect_callback);
+	selection_prune(dst);
+}
+
+static bool selection_subtract_callback(void* key, void* value, void* user) {
+	struct selection_chunk* src = (struct selection_chunk*)value;
+	struct selection_chunk* dst
+		= ht_lookup(&((struct selection*)user)->chunks, key);
+
+	if(dst) {
+		for(size_t k = 0; k < SELECTION_WORDS; k++)
+			dst->bits[k] &= ~src->bits[k];
+	}
+
+	return true;
+}
+
+void selection_subtract(struct selection* dst, struct selection* src) {
+	assert(dst && src && dst != src);
+
+	ht_iterate(&src->chunks, dst, selection_subtract_callback);
+	selection_prune(dst);
+}
+
+void selection_invert(struct selection* s, int* min, int* max) {
+	assert(s && min && max);
+	assert(min[0] <= max[0] && min[1] <= max[1] && min[2] <= max[2]);
+
+	selection_apply_box(s, min, max, true);
+
+	selection_prune(s);
+}
+
+/*
+	Shifts the mask by one voxel in every face direction, bits crossing the
+	chunk border come from the neighbor masks in render_face order. Grow
+	combines all seven with or, shrink with and.
+*/
+static void selection_morph_chunk(const struct selection_chunk* m,
+								  const struct selection_chunk** n, bool grow,
+								  struct selection_chunk* out) {
+	for(size_t w = 0; w < SELECTION_WORDS; w++) {
+		size_t y = w / 4;
+		size_t row = w % 4;
+		uint64_t v = m->bits[w];
+
+		// each holds the value of the voxel one step in that direction
+		uint64_t right = ((v >> 1) & ~SELECTION_LANE_HIGH)
+			| ((n[FACE_RIGHT]->bits[w] & SELECTION_LANE_LOW) << 15);
+		uint64_t left = ((v << 1) & ~SELECTION_LANE_LOW)
+			| ((n[FACE_LEFT]->bits[w] & SELECTION_LANE_HIGH) >> 15);
+		uint64_t top = (v >> 16)
+			| ((row < 3 ? m->bits[w + 1] : n[FACE_TOP]->bits[y * 4]) << 48);
+		uint64_t bottom = (v << 16)
+			| ((row > 0 ? m->bits[w - 1] : n[FACE_BOTTOM]->bits[y * 4 + 3])
+			   >> 48);
+		uint64_t back = (y < LAYER_CHUNK_SIZE - 1) ? m->bits[w + 4] :
+													 n[FACE_BACK]->bits[w - 60];
+		uint64_t front
+			= (y > 0) ? m->bits[w - 4] : n[FACE_FRONT]->bits[w + 60];
+
+		out->bits[w] = grow ? v | right | left | back | front | top | bottom :
+							  v & right & left & back & front & top & bottom;
+	}
+}
+
+static void selection_morph_at(struct selection_morph* ctx, int x, int y,
+							   int z) {
+	if(ht_lookup(ctx->dst, (int[3]) {x, y, z}))
+		return;
+
+	const struct selection_chunk* m
+		= ht_lookup(&ctx->src->chunks, (int[3]) {x, y, z});
+	const struct selection_chunk* n[6];
+
+	for(int face = 0; face < 6; face++) {
+		n[face] = ht_lookup(&ctx->src->chunks,
+							(int[3]) {x + render_face_normals[face][0],
+									  y + render_face_normals[face][1],
+									  z + render_face_normals[face][2]});
+
+		if(!n[face])
+			n[face] = &selection_none;
+	}
+
+	struct selection_chunk out;
+	selection_morph_chunk(m ? m : &selection_none, n, ctx->grow, &out);
+
+	if(!selection_chunk_empty(&out))
+		ht_insert(ctx->dst, (int[3]) {x, y, z}, &out);
+}
+
+static bool selection_morph_callback(void* key, void* value, void* user) {
+	struct selection_morph* ctx = (struct selection_morph*)user;
+	int* pos = (int*)key;
+
+	selection_morph_at(ctx, pos[0], pos[1], pos[2]);
+
+	// growing may spill into the neighbor chunks
+	for(int face = 0; face < 6 && ctx->grow; face++)
+		selection_morph_at(ctx, pos[0] + render_face_normals[face][0],
+						   pos[1] + render_face_normals[face][1],
+						   pos[2] + render_face_normals[face][2]);
+
+	return true;
+}
+
+static void selection_morph(struct selection* s, bool grow) {
+	HashTable result;
+	layer_chunk_table(&result, sizeof(struct selection_chunk));
+
+	struct selection_morph ctx = {.src = s, .dst = &result, .grow = grow};
+	ht_iterate(&s->chunks, &ctx, selection_morph_callback);
+
+	ht_destroy(&s->chunks);
+	s->chunks = result;
+}
+
+void selection_grow(struct selection* s) {
+	assert(s);
+	selection_morph(s, true);
+}
+
+void selection_shrink(struct selection* s) {
+	assert(s);
+	selection_morph(s, false);
+}
+
+static bool selection_translate_callback(void* key, void* value, void* user) {
+	struct selection_offset* ctx = (struct selection_offset*)user;
+	struct selection_chunk* c = (struct selection_chunk*)value;
+	int* pos = (int*)key;
+	int* offset = ctx->offset;
+
+	for(size_t w = 0; w < SELECTION_WORDS; w++) {
+		for(uint64_t bits = c->bits[w]; bits; bits &= bits - 1) {
+			size_t index = w * 64 + selection_lowest_bit(bits);
+			int x = pos[0] * LAYER_CHUNK_SIZE + index % LAYER_CHUNK_SIZE
+				+ offset[0];
+			int y = pos[1] * LAYER_CHUNK_SIZE
+				+ index / (LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE) + offset[1];
+			int z = pos[2] * LAYER_CHUNK_SIZE
+				+ index / LAYER_CHUNK_SIZE % LAYER_CHUNK_SIZE + offset[2];
+
+			struct selection_chunk* dst
+				= ht_lookup(ctx->dst, SELECTION_KEY(x, y, z));
+
+			if(!dst) {
+				ht_insert(ctx->dst, SELECTION_KEY(x, y, z),
+						  (void*)&selection_none);
+				dst = ht_lookup(ctx->dst, SELECTION_KEY(x, y, z));
+			}
+
+			size_t target
+				= LAYER_CHUNK_INDEX(LAYER_LOCAL_COORD(x), LAYER_LOCAL_COORD(y),
+									LAYER_LOCAL_COORD(z));
+			dst->bits[target / 64] |= 1ULL << (target % 64);
+		}
+	}
+
+	return true;
+}
+
+static bool selection_rekey_callback(void* key, void* value, void* user) {
+	struct selection_offset* ctx = (struct selection_offset*)user;
+	int* pos = (int*)key;
+	int* offset = ctx->offset;
+
+	ht_insert(ctx->dst,
+			  (int[3]) {pos[0] + offset[0] / LAYER_CHUNK_SIZE,
+						pos[1] + offset[1] / LAYER_CHUNK_SIZE,
+						pos[2] + offset[2] / LAYER_CHUNK_SIZE},
+			  value);
+	return true;
+}
+
+void selection_translate(struct selection* s, int dx, int dy, int dz) {
+	assert(s);
+
+	HashTable result;
+	layer_chunk_table(&result, sizeof(struct selection_chunk));
+
+	struct selection_offset ctx = {.offset = {dx, dy, dz}, .dst = &result};
+
+	// whole chunk steps keep all masks as they are
+	if(LAYER_LOCAL_COORD(dx) == 0 && LAYER_LOCAL_COORD(dy) == 0
+	   && LAYER_LOCAL_COORD(dz) == 0) {
+		ht_iterate(&s->chunks, &ctx, selection_rekey_callback);
+	} else {
+		ht_iterate(&s->chunks, &ctx, selection_translate_callback);
+	}
+
+	ht_destroy(&s->chunks);
+	s->chunks = result;
+}
+
+static bool selection_recolor_callback(void* key, void* value, void* user) {
+	struct selection_voxels* ctx = (struct selection_voxels*)user;
+	struct selection_chunk* mask = (struct selection_chunk*)value;
+	int* pos = (int*)key;
+
+	struct layer_chunk* c
+		= layer_get_chunk(ctx->l, pos[0], pos[1], pos[2], false);
+
+	if(!c)
+		return true;
+
+	struct layer_chunk_block* blocks = NULL;
+
+	for(size_t w = 0; w < SELECTION_WORDS; w++) {
+		for(uint64_t bits = mask->bits[w]; bits; bits &= bits - 1) {
+			size_t index = w * 64 + selection_lowest_bit(bits);
+			struct layer_chunk_block* b
+				= (blocks ? blocks : c->payload->blocks) + index;
+
+			if(!b->solid
+			   || (b->color.red == ctx->color.red
+				   && b->color.green == ctx->color.green
+				   && b->color.blue == ctx->color.blue))
+				continue;
+
+			// only unshare the payload once something actually changes
+			if(!blocks)
+				blocks = layer_chunk_edit_begin(c);
+
+			stats_add_color(c->stats.layer, blocks[index].color, -1);
+			stats_add_color(c->stats.layer, ctx->color, 1);
+			blocks[index].color = ctx->color;
+		}
+	}
+
+	if(blocks)
+		layer_chunk_edit_end(c);
+
+	return true;
+}
+
+void selection_recolor(struct selection* s, struct layer* l,
+					   struct color color) {
+	assert(s && l);
+
+	struct selection_voxels ctx = {.l = l, .color = color};
+	ht_iterate(&s->chunks, &ctx, selection_recolor_callback);
+}
+
+static bool selection_delete_callback(void* key, void* value, void* user) {
+	struct selection_voxels* ctx = (struct selection_voxels*)user;
+	struct selection_chunk* mask = (struct selection_chunk*)value;
+	int* pos = (int*)key;
+
+	struct layer_chunk* c
+		= layer_get_chunk(ctx->l, pos[0], pos[1], pos[2], false);
+
+	if(!c)
+		return true;
+
+	struct layer_chunk_block* blocks = NULL;
+
+	for(size_t w = 0; w < SELECTION_WORDS; w++) {
+		for(uint64_t bits = mask->bits[w]; bits; bits &= bits - 1) {
+			size_t index = w * 64 + selection_lowest_bit(bits);
+
+			if(!(blocks ? blocks : c->payload->blocks)[index].solid)
+				continue;
+
+			if(!blocks)
+				blocks = layer_chunk_edit_begin(c);
+
+			stats_add_voxel(
+				c->stats.layer,
+				pos[0] * LAYER_CHUNK_SIZE + index % LAYER_CHUNK_SIZE,
+				pos[1] * LAYER_CHUNK_SIZE
+					+ index / (LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE),
+				pos[2] * LAYER_CHUNK_SIZE
+					+ index / LAYER_CHUNK_SIZE % LAYER_CHUNK_SIZE,
+				blocks[index].color, -1);
+			blocks[index] = (struct layer_chunk_block) {.solid = false};
+			c->solid_blocks--;
+		}
+	}
+
+	if(blocks) {
+		layer_chunk_edit_end(c);
+
+		if(!c->solid_blocks)
+			layer_remove_chunk(ctx->l, c);
+	}
+
+	return true;
+}
+
+void selection_delete(struct selection* s, struct layer* l) {
+	assert(s && l);
+
+	// removing chunks from the layer is fine, only the selection is iterated
+	struct selection_voxels ctx = {.l = l};
+	ht_iterate(&s->chunks, &ctx, selection_delete_callback);
+}
+
+static bool selection_gather_callback(void* key, void* value, void* user) {
+	struct selection_voxels* ctx = (struct selection_voxels*)user;
+	struct selection_chunk* mask = (struct selection_chunk*)value;
+	int* pos = (int*)key;
+
+	struct layer_chunk* c
+		= layer_get_chunk(ctx->l, pos[0], pos[1], pos[2], false);
+
+	if(!c)
+		return true;
+
+	for(size_t w = 0; w < SELECTION_WORDS; w++) {
+		for(uint64_t bits = mask->bits[w]; bits; bits &= bits - 1) {
+			size_t index = w * 64 + selection_lowest_bit(bits);
+			struct layer_chunk_block* b = c->payload->blocks + index;
+
+			if(b->solid)
+				edit_batch_set_solid(
+					ctx->batch,
+					pos[0] * LAYER_CHUNK_SIZE + index % LAYER_CHUNK_SIZE
+						+ ctx->offset[0],
+					pos[1] * LAYER_CHUNK_SIZE
+						+ index / (LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE)
+						+ ctx->offset[1],
+					pos[2] * LAYER_CHUNK_SIZE
+						+ index / LAYER_CHUNK_SIZE % LAYER_CHUNK_SIZE
+						+ ctx->offset[2],
+					b->color);
+		}
+	}
+
+	return true;
+}
+
+static void selection_gather(struct selection* s, struct layer* l,
+							 struct edit_batch* batch, int dx, int dy,
+							 int dz) {
+	struct selection_voxels ctx = {
+		.l = l,
+		.batch = batch,
+		.offset = {dx, dy, dz},
+	};
+
+	ht_iterate(&s->chunks, &ctx, selection_gather_callback);
+}
+
+void selection_copy_voxels(struct selection* s, struct layer* src,
+						   struct layer* dst, int dx, int dy, int dz) {
+	assert(s && src && dst);
+
+	// read everything first, source and destination may overlap
+	struct edit_batch batch;
+	edit_batch_create(&batch);
+	selection_gather(s, src, &batch, dx, dy, dz);
+	edit_batch_apply(&batch, dst, NULL);
+	edit_batch_destroy(&batch);
+}
+
+void selection_move(struct selection* s, struct layer* l, int dx, int dy,
+					int dz) {
+	assert(s && l);
+
+	struct edit_batch batch;
+	edit_batch_create(&batch);
+	selection_gather(s, l, &batch, dx, dy, dz);
+	selection_delete(s, l);
+	edit_batch_apply(&batch, l, NULL);
+	edit_batch_destroy(&batch);
+
+	selection_translate(s, dx, dy, dz);
+}
@@ -0,0 +1,82 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_SELECTION_H
+#define PINKED_SELECTION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "hashtable.h"
+#include "layer.h"
+
+#define SELECTION_WORDS (LAYER_CHUNK_VOLUME / 64)
+
+// bit k of the mask is the voxel at LAYER_CHUNK_INDEX order k
+struct selection_chunk {
+	uint64_t bits[SELECTION_WORDS];
+};
+
+/*
+	Sparse set of voxels, one mask per chunk in world chunk coordinates.
+	Chunks without any selected voxel are never stored. Boxes are given as
+	inclusive minimum and maximum voxel coordinates.
+*/
+struct selection {
+	HashTable chunks;
+};
+
+void selection_create(struct selection* s);
+void selection_copy(struct selection* dst, struct selection* src);
+void selection_destroy(struct selection* s);
+void selection_clear(struct selection* s);
+
+size_t selection_count(struct selection* s);
+bool selection_contains(struct selection* s, int x, int y, int z);
+void selection_set(struct selection* s, int x, int y, int z, bool selected);
+
+void selection_add_box(struct selection* s, int* min, int* max);
+// all solid voxels of a layer, each channel within tolerance if matching
+void selection_add_solid(struct selection* s, struct layer* l);
+void selection_add_color(struct selection* s, struct layer* l,
+						 struct color color, int tolerance);
+
+void selection_union(struct selection* dst, struct selection* src);
+void selection_intersect(struct selection* dst, struct selection* src);
+void selection_subtract(struct selection* dst, struct selection* src);
+void selection_invert(struct selection* s, int* min, int* max);
+
+// one step of dilation or erosion with the 6 face neighbors
+void selection_grow(struct selection* s);
+void selection_shrink(struct selection* s);
+void selection_translate(struct selection* s, int dx, int dy, int dz);
+
+// operate on the selected solid voxels of a layer
+void selection_recolor(struct selection* s, struct layer* l,
+					   struct color color);
+void selection_delete(struct selection* s, struct layer* l);
+void selection_copy_voxels(struct selection* s, struct layer* src,
+						   struct layer* dst, int dx, int dy, int dz);
+// also moves the selection along
+void selection_move(struct selection* s, struct layer* l, int dx, int dy,
+					int dz);
+
+#endif
@@ -0,0 +1,425 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chunk.h"
+#include "stats.h"
+
+// pending counts of recently seen colors, flushed to the table on collision
+#define STATS_CACHE_BITS 6
+
+struct stats_pending {
+	uint32_t color;
+	size_t count;
+};
+
+static uint32_t stats_pack(struct color c) {
+	return c.red | (uint32_t)c.green << 8 | (uint32_t)c.blue << 16;
+}
+
+static void stats_axis_create(struct stats_axis* a) {
+	a->planes = NULL;
+	a->base = 0;
+	a->length = 0;
+	a->min = a->max = 0;
+	a->solid = 0;
+}
+
+static void stats_axis_reserve(struct stats_axis* a, int coord) {
+	if(a->length && coord >= a->base && coord < a->base + (int)a->length)
+		return;
+
+	int lo = (a->length && a->base < coord) ? a->base : coord;
+	int hi = (a->length && a->base + (int)a->length - 1 > coord) ?
+		a->base + (int)a->length - 1 :
+		coord;
+
+	size_t length = hi - lo + 1;
+
+	if(length < a->length * 2)
+		length = a->length * 2;
+
+	if(length < 64)
+		length = 64;
+
+	// grows towards the new coordinate
+	int base = (a->length && coord < a->base) ? hi - (int)length + 1 :
+												lo - (a->length ? 0 : 32);
+	size_t* planes = calloc(length, sizeof(size_t));
+	assert(planes);
+
+	if(a->length)
+		memcpy(planes + (a->base - base), a->planes,
+			   a->length * sizeof(size_t));
+
+	free(a->planes);
+	a->planes = planes;
+	a->base = base;
+	a->length = length;
+}
+
+// adds counts to consecutive planes starting at coordinate start
+static void stats_axis_add(struct stats_axis* a, int start, size_t* counts,
+						   size_t length, int sign) {
+	int first = 0, last = (int)length - 1;
+
+	while(first <= last && !counts[first])
+		first++;
+
+	while(last >= first && !counts[last])
+		last--;
+
+	if(first > last)
+		return;
+
+	stats_axis_reserve(a, start + first);
+	stats_axis_reserve(a, start + last);
+
+	size_t* planes = a->planes + (start - a->base);
+	size_t total = 0;
+
+	for(int k = first; k <= last; k++) {
+		assert(sign > 0 || planes[k] >= counts[k]);
+		planes[k] = (sign > 0) ? planes[k] + counts[k] : planes[k] - counts[k];
+		total += counts[k];
+	}
+
+	if(sign > 0) {
+		if(!a->solid || start + first < a->min)
+			a->min = start + first;
+
+		if(!a->solid || start + last > a->max)
+			a->max = start + last;
+
+		a->solid += total;
+	} else {
+		a->solid -= total;
+
+		// the bounds only move inwards, passing each plane once
+		if(a->solid) {
+			while(!a->planes[a->min - a->base])
+				a->min++;
+
+			while(!a->planes[a->max - a->base])
+				a->max--;
+		}
+	}
+}
+
+static void stats_count_color(struct stats* s, uint32_t color, size_t count,
+							  int sign) {
+	size_t* voxels = ht_lookup(&s->colors, &color);
+
+	if(sign > 0) {
+		if(voxels) {
+			*voxels += count;
+		} else {
+			ht_insert(&s->colors, &color, &count);
+		}
+	} else {
+		assert(voxels && *voxels >= count);
+		*voxels -= count;
+
+		if(!*voxels)
+			ht_erase(&s->colors, &color);
+	}
+}
+
+void stats_create(struct stats* s) {
+	assert(s);
+
+	s->solid = 0;
+	s->chunks = 0;
+	s->memory = 0;
+	s->gpu_bytes = 0;
+	ht_setup(&s->colors, sizeof(uint32_t), sizeof(size_t), 64);
+	ht_setup(&s->payloads, sizeof(struct layer_chunk_payload*),
+			 sizeof(size_t), 64);
+
+	for(int k = 0; k < 3; k++)
+		stats_axis_create(s->axes + k);
+}
+
+void stats_destroy(struct stats* s) {
+	assert(s);
+
+	ht_destroy(&s->colors);
+	ht_destroy(&s->payloads);
+
+	for(int k = 0; k < 3; k++)
+		free(s->axes[k].planes);
+}
+
+void stats_clear_voxels(struct stats* s) {
+	assert(s);
+
+	s->solid = 0;
+	ht_clear(&s->colors);
+
+	for(int k = 0; k < 3; k++) {
+		free(s->axes[k].planes);
+		stats_axis_create(s->axes + k);
+	}
+}
+
+struct stats_merge_context {
+	struct stats* dst;
+	int sign;
+};
+
+static bool stats_merge_callback(void* key, void* value, void* user) {
+	struct stats_merge_context* ctx = (struct stats_merge_context*)user;
+	stats_count_color(ctx->dst, *(uint32_t*)key, *(size_t*)value, ctx->sign);
+	return true;
+}
+
+void stats_merge_voxels(struct stats* dst, struct stats* src, int sign) {
+	assert(dst && src && (sign == 1 || sign == -1));
+
+	struct stats_merge_context ctx = {.dst = dst, .sign = sign};
+
+	assert(sign > 0 || dst->solid >= src->solid);
+	dst->solid = (sign > 0) ? dst->solid + src->solid : dst->solid - src->solid;
+	ht_iterate(&src->colors, &ctx, stats_merge_callback);
+
+	for(int k = 0; k < 3; k++) {
+		struct stats_axis* a = src->axes + k;
+
+		stats_axis_add(dst->axes + k, a->base, a->planes, a->length, sign);
+	}
+}
+
+void stats_add_voxel(struct stats* s, int x, int y, int z, struct color color,
+					 int sign) {
+	assert(s && (sign == 1 || sign == -1));
+
+	int pos[3] = {x, y, z};
+	size_t one = 1;
+
+	s->solid += sign;
+	stats_count_color(s, stats_pack(color), 1, sign);
+
+	for(int k = 0; k < 3; k++)
+		stats_axis_add(s->axes + k, pos[k], &one, 1, sign);
+}
+
+void stats_add_color(struct stats* s, struct color color, int sign) {
+	assert(s && (sign == 1 || sign == -1));
+	stats_count_color(s, stats_pack(color), 1, sign);
+}
+
+// collects counts per color, only touches the table on collisions
+static void stats_pend(struct stats* s, struct stats_pending* pending,
+					   uint32_t color, size_t count, int sign) {
+	struct stats_pending* p
+		= pending + ((color * 2654435761U) >> (32 - STATS_CACHE_BITS));
+
+	if(p->count && p->color != color) {
+		stats_count_color(s, p->color, p->count, sign);
+		p->count = 0;
+	}
+
+	p->color = color;
+	p->count += count;
+}
+
+static bool stats_uniform(struct layer_chunk_block* blocks, size_t length) {
+	// compares whole blocks as words without branching
+	uint32_t first, block;
+	bool uniform = true;
+
+	assert(sizeof(struct layer_chunk_block) == sizeof(uint32_t));
+	memcpy(&first, blocks, sizeof(uint32_t));
+
+	for(size_t k = 0; k < length; k++) {
+		memcpy(&block, blocks + k, sizeof(uint32_t));
+		uniform &= block == first;
+	}
+
+	return uniform;
+}
+
+void stats_add_chunk(struct stats* s, struct layer_chunk* c, int sign) {
+	assert(s && c && c->payload && (sign == 1 || sign == -1));
+
+	if(!c->solid_blocks)
+		return;
+
+	struct stats_pending pending[1 << STATS_CACHE_BITS] = {0};
+	size_t planes[3][LAYER_CHUNK_SIZE] = {0};
+	size_t solid = 0;
+
+	// filled chunks are common, e.g. inside of shape brushes
+	if(c->solid_blocks == LAYER_CHUNK_VOLUME
+	   && stats_uniform(c->payload->blocks, LAYER_CHUNK_VOLUME)) {
+		solid = LAYER_CHUNK_VOLUME;
+		stats_count_color(s, stats_pack(c->payload->blocks[0].color), solid,
+						  sign);
+
+		for(int a = 0; a < 3; a++) {
+			for(int k = 0; k < LAYER_CHUNK_SIZE; k++)
+				planes[a][k] = LAYER_CHUNK_SIZE * LAYER_CHUNK_SIZE;
+		}
+	} else {
+		for(int z = 0; z < LAYER_CHUNK_SIZE; z++) {
+			for(int y = 0; y < LAYER_CHUNK_SIZE; y++) {
+				struct layer_chunk_block* row
+					= c->payload->blocks + LAYER_CHUNK_INDEX(0, y, z);
+				size_t row_solid = 0;
+				uint32_t run = 0;
+				size_t run_length = 0;
+
+				if(stats_uniform(row, LAYER_CHUNK_SIZE)) {
+					if(!row->solid)
+						continue;
+
+					stats_pend(s, pending, stats_pack(row->color),
+							   LAYER_CHUNK_SIZE, sign);
+
+					for(int x = 0; x < LAYER_CHUNK_SIZE; x++)
+						planes[0][x]++;
+
+					planes[1][y] += LAYER_CHUNK_SIZE;
+					planes[2][z] += LAYER_CHUNK_SIZE;
+					solid += LAYER_CHUNK_SIZE;
+					continue;
+				}
+
+				for(int x = 0; x < LAYER_CHUNK_SIZE; x++) {
+					if(!row[x].solid)
+						continue;
+
+					uint32_t color = stats_pack(row[x].color);
+
+					if(run_length && color != run) {
+						stats_pend(s, pending, run, run_length, sign);
+						run_length = 0;
+					}
+
+					run = color;
+					run_length++;
+					planes[0][x]++;
+					row_solid++;
+				}
+
+				if(run_length)
+					stats_pend(s, pending, run, run_length, sign);
+
+				planes[1][y] += row_solid;
+				planes[2][z] += row_solid;
+				solid += row_solid;
+			}
+		}
+
+		for(size_t k = 0; k < (1 << STATS_CACHE_BITS); k++) {
+			if(pending[k].count)
+				stats_count_color(s, pending[k].color, pending[k].count,
+								  sign);
+		}
+	}
+
+	s->solid = (sign > 0) ? s->solid + solid : s->solid - solid;
+
+	int base[3] = {c->x, c->y, c->z};
+
+	for(int a = 0; a < 3; a++)
+		stats_axis_add(s->axes + a, base[a] * LAYER_CHUNK_SIZE, planes[a],
+					   LAYER_CHUNK_SIZE, sign);
+}
+
+void stats_add_payload(struct stats* s, struct layer_chunk_payload* p,
+					   int sign) {
+	assert(s && p && (sign == 1 || sign == -1));
+
+	size_t* chunks = ht_lookup(&s->payloads, &p);
+
+	if(sign > 0) {
+		if(chunks) {
+			(*chunks)++;
+		} else {
+			size_t one = 1;
+			ht_insert(&s->payloads, &p, &one);
+			s->memory += sizeof(struct layer_chunk_payload);
+		}
+	} else {
+		assert(chunks && *chunks > 0);
+
+		if(!--*chunks) {
+			ht_erase(&s->payloads, &p);
+			s->memory -= sizeof(struct layer_chunk_payload);
+		}
+	}
+}
+
+size_t stats_color(struct stats* s, struct color color) {
+	assert(s);
+
+	uint32_t key = stats_pack(color);
+	size_t* voxels = ht_lookup(&s->colors, &key);
+
+	return voxels ? *voxels : 0;
+}
+
+struct stats_colors_context {
+	void* user;
+	bool (*callback)(struct color color, size_t voxels, void* user);
+};
+
+static bool stats_colors_callback(void* key, void* value, void* user) {
+	struct stats_colors_context* ctx = (struct stats_colors_context*)user;
+	uint32_t color = *(uint32_t*)key;
+
+	return ctx->callback(
+		(struct color) {
+			.red = color & 0xFF,
+			.green = (color >> 8) & 0xFF,
+			.blue = color >> 16,
+		},
+		*(size_t*)value, ctx->user);
+}
+
+void stats_colors(struct stats* s, void* user,
+				  bool (*callback)(struct color color, size_t voxels,
+								   void* user)) {
+	assert(s && callback);
+
+	ht_iterate(&s->colors,
+			   &(struct stats_colors_context) {
+				   .user = user,
+				   .callback = callback,
+			   },
+			   stats_colors_callback);
+}
+
+bool stats_bounds(struct stats* s, int* min, int* max) {
+	assert(s && min && max);
+
+	if(!s->solid)
+		return false;
+
+	for(int k = 0; k < 3; k++) {
+		min[k] = s->axes[k].min;
+		max[k] = s->axes[k].max;
+	}
+
+	return true;
+}
@@ -0,0 +1,86 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_STATS_H
+#define PINKED_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color.h"
+#include "hashtable.h"
+
+struct layer_chunk;
+struct layer_chunk_payload;
+
+struct stats_axis {
+	// solid voxels per plane, planes[k] is at coordinate base + k
+	size_t* planes;
+	int base;
+	size_t length;
+	// planes beyond min and max are empty, valid if solid > 0
+	int min, max;
+	size_t solid;
+};
+
+/*
+	Aggregates of a layer, every chunk of the layer points to them and
+	updates them on each change, see layer_stats(). Memory counts each
+	payload once, no matter how many chunks share it, plus the detail
+	levels and meshes of each chunk as of its last change.
+
+	Not thread-safe, only update from the main thread.
+*/
+struct stats {
+	size_t solid;
+	size_t chunks;
+	size_t memory;
+	size_t gpu_bytes;
+	// packed color to its number of solid voxels
+	HashTable colors;
+	// payload pointer to the number of chunks using it
+	HashTable payloads;
+	struct stats_axis axes[3];
+};
+
+void stats_create(struct stats* s);
+void stats_destroy(struct stats* s);
+// forgets all voxels, chunks and memory stay counted
+void stats_clear_voxels(struct stats* s);
+// sign -1 removes voxels that were merged or counted before
+void stats_merge_voxels(struct stats* dst, struct stats* src, int sign);
+
+// sign is 1 to add and -1 to remove
+void stats_add_voxel(struct stats* s, int x, int y, int z, struct color color,
+					 int sign);
+void stats_add_color(struct stats* s, struct color color, int sign);
+// all solid blocks of a resident chunk
+void stats_add_chunk(struct stats* s, struct layer_chunk* c, int sign);
+// memory of a payload is counted while any chunk of the layer uses it
+void stats_add_payload(struct stats* s, struct layer_chunk_payload* p,
+					   int sign);
+
+size_t stats_color(struct stats* s, struct color color);
+void stats_colors(struct stats* s, void* user,
+				  bool (*callback)(struct color color, size_t voxels,
+								   void* user));
+bool stats_bounds(struct stats* s, int* min, int* max);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include <SDL2/SDL.h>
+
+#include "thread_pool.h"
+
+static struct {
+	bool init;
+	bool quit;
+	SDL_Thread** threads;
+	size_t count;
+	SDL_mutex* lock;
+	SDL_cond* wake;
+	SDL_cond* done;
+	size_t generation;
+	thread_pool_job func;
+	void* user;
+	size_t jobs;
+	size_t next;
+	size_t finished;
+	// batches with jobs left to start, see thread_pool_start()
+	struct thread_pool_batch* background;
+	struct thread_pool_batch* background_last;
+} pool;
+
+// expects the pool to be locked, returns with the pool locked
+static void thread_pool_work(void) {
+	while(pool.next < pool.jobs) {
+		size_t job = pool.next++;
+
+		SDL_UnlockMutex(pool.lock);
+		pool.func(job, pool.user);
+		SDL_LockMutex(pool.lock);
+
+		if(++pool.finished == pool.jobs)
+			SDL_CondBroadcast(pool.done);
+	}
+}
+
+// runs one queued background job, same locking as thread_pool_work()
+static void thread_pool_work_background(void) {
+	struct thread_pool_batch* b = pool.background;
+	size_t job = b->next++;
+
+	if(b->next == b->jobs) {
+		pool.background = b->queued;
+
+		if(!pool.background)
+			pool.background_last = NULL;
+	}
+
+	SDL_UnlockMutex(pool.lock);
+	b->func(job, b->user);
+	SDL_LockMutex(pool.lock);
+
+	if(++b->finished == b->jobs)
+		SDL_CondBroadcast(pool.done);
+}
+
+static int thread_pool_worker(void* user) {
+	size_t generation = 0;
+
+	SDL_LockMutex(pool.lock);
+
+	while(1) {
+		while(!pool.quit && pool.generation == generation
+			  && !pool.background)
+			SDL_CondWait(pool.wake, pool.lock);
+
+		if(pool.quit)
+			break;
+
+		// jobs of thread_pool_run() go first, its caller is waiting
+		if(pool.generation != generation) {
+			generation = pool.generation;
+			thread_pool_work();
+		} else {
+			thread_pool_work_background();
+		}
+	}
+
+	SDL_UnlockMutex(pool.lock);
+
+	return 0;
+}
+
+static void thread_pool_init(void) {
+	if(pool.init)
+		return;
+
+	pool.init = true;
+	pool.quit = false;
+	pool.generation = 0;
+	pool.jobs = pool.next = pool.finished = 0;
+	pool.background = pool.background_last = NULL;
+	pool.lock = SDL_CreateMutex();
+	pool.wake = SDL_CreateCond();
+	pool.done = SDL_CreateCond();
+
+	// the calling thread works too
+	int cpus = SDL_GetCPUCount();
+	pool.count = (cpus > 1) ? cpus - 1 : 0;
+	pool.threads = malloc((pool.count + 1) * sizeof(SDL_Thread*));
+	assert(pool.threads);
+
+	for(size_t k = 0; k < pool.count; k++) {
+		pool.threads[k]
+			= SDL_CreateThread(thread_pool_worker, "pinked worker", NULL);
+		assert(pool.threads[k]);
+	}
+}
+
+void thread_pool_run(size_t count, thread_pool_job func, void* user) {
+	assert(func);
+
+	thread_pool_init();
+
+	if(count <= 1 || !pool.count) {
+		for(size_t k = 0; k < count; k++)
+			func(k, user);
+		return;
+	}
+
+	SDL_LockMutex(pool.lock);
+	assert(pool.finished == pool.jobs);
+
+	pool.func = func;
+	pool.user = user;
+	pool.jobs = count;
+	pool.next = 0;
+	pool.finished = 0;
+	pool.generation++;
+	SDL_CondBroadcast(pool.wake);
+
+	thread_pool_work();
+
+	while(pool.finished < pool.jobs)
+		SDL_CondWait(pool.done, pool.lock);
+
+	SDL_UnlockMutex(pool.lock);
+}
+
+void thread_pool_start(struct thread_pool_batch* b, size_t count,
+					   thread_pool_job func, void* user) {
+	assert(b && func);
+
+	thread_pool_init();
+
+	b->func = func;
+	b->user = user;
+	b->jobs = count;
+	b->next = 0;
+	b->finished = 0;
+	b->queued = NULL;
+
+	if(!count || !pool.count) {
+		for(size_t k = 0; k < count; k++)
+			func(k, user);
+
+		b->next = b->finished = count;
+		return;
+	}
+
+	SDL_LockMutex(pool.lock);
+
+	if(pool.background_last)
+		pool.background_last->queued = b;
+	else
+		pool.background = b;
+
+	pool.background_last = b;
+	SDL_CondBroadcast(pool.wake);
+	SDL_UnlockMutex(pool.lock);
+}
+
+bool thread_pool_done(struct thread_pool_batch* b) {
+	assert(b);
+
+	if(!pool.count)
+		return b->finished == b->jobs;
+
+	SDL_LockMutex(pool.lock);
+	bool done = b->finished == b->jobs;
+	SDL_UnlockMutex(pool.lock);
+
+	return done;
+}
+
+void thread_pool_wait(struct thread_pool_batch* b) {
+	assert(b);
+
+	if(!pool.count)
+		return;
+
+	SDL_LockMutex(pool.lock);
+
+	while(b->finished < b->jobs)
+		SDL_CondWait(pool.done, pool.lock);
+
+	SDL_UnlockMutex(pool.lock);
+}
+
+size_t thread_pool_threads(void) {
+	thread_pool_init();
+	return pool.count + 1;
+}
+
+void thread_pool_destroy(void) {
+	if(!pool.init)
+		return;
+
+	SDL_LockMutex(pool.lock);
+	// owners wait for their batches before shutting down
+	assert(!pool.background);
+	pool.quit = true;
+	SDL_CondBroadcast(pool.wake);
+	SDL_UnlockMutex(pool.lock);
+
+	for(size_t k = 0; k < pool.count; k++)
+		SDL_WaitThread(pool.threads[k], NULL);
+
+	free(pool.threads);
+	SDL_DestroyCond(pool.done);
+	SDL_DestroyCond(pool.wake);
+	SDL_DestroyMutex(pool.lock);
+	pool.init = false;
+}
@@ -0,0 +1,59 @@
+/*
+	Copyright (c) 2022 ByteBit/xtreme8000
+
+	This file is part of PinkEd.
+
+	PinkEd is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	PinkEd is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with PinkEd.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PINKED_THREAD_POOL_H
+#define PINKED_THREAD_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef void (*thread_pool_job)(size_t job, void* user);
+
+// jobs started by thread_pool_start(), owned by the caller
+struct thread_pool_batch {
+	thread_pool_job func;
+	void* user;
+	size_t jobs;
+	size_t next;
+	size_t finished;
+	struct thread_pool_batch* queued;
+};
+
+/*
+	Background worker threads shared by the whole program, started on first
+	use. thread_pool_run() distributes jobs 0 to count - 1 over all workers
+	and the calling thread and returns once every job has finished. Jobs must
+	not call thread_pool_run() themselves.
+*/
+void thread_pool_run(size_t count, thread_pool_job func, void* user);
+
+/*
+	Queues jobs 0 to count - 1 and returns right away, workers pick them up
+	whenever thread_pool_run() leaves them idle. The batch has to stay valid
+	until thread_pool_done() returns true or thread_pool_wait() returns.
+	Without any worker threads the jobs run before this returns.
+*/
+void thread_pool_start(struct thread_pool_batch* b, size_t count,
+					   thread_pool_job func, void* user);
+bool thread_pool_done(struct thread_pool_batch* b);
+void thread_pool_wait(struct thread_pool_batch* b);
+size_t thread_pool_threads(void);
+void thread_pool_destroy(void);
+
+#endif